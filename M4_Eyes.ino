@@ -31,6 +31,9 @@
 
 #define GLOBAL_VAR
 #include "globals.h"
+#if defined(FIXED_TABLES)
+  #include "fixedtables.h" // 由 tools/bakeeye 生成
+#endif
 
 // 适用于所有眼睛的全局状态（不是每只眼睛）：
 bool     eyeInMotion = false; // 眼睛是否在移动
@@ -52,12 +55,16 @@ uint32_t lastFrameRateReportTime = 0; // 上次帧率报告时间
 uint32_t lastLightReadTime       = 0; // 上次光线读取时间
 float    lastLightValue          = 0.5; // 上次光线值
 double   irisValue               = 0.5; // 虹膜值
-int      iPupilFactor            = 42; // 瞳孔因子
 uint32_t boopSum                 = 0, // 触摸传感器总和
          boopSumFiltered         = 0; // 过滤后的触摸传感器总和
+uint16_t boopCount               = 0; // boopSum 中的读取组数（每组 BOOP_READS 次）
 bool     booped                  = false; // 是否被触摸
 int      fixate                  = 7; // 注视点
 uint8_t  lightSensorFailCount    = 0; // 光线传感器失败计数
+uint32_t renderTime              = 0; // 上次报告以来 loop() 渲染列的累计时间（微秒）
+uint32_t reportFrames            = 0; // 上次报告时的 frames
+volatile uint32_t dmaJobs        = 0; // 上次报告以来的 DMA 作业数
+uint32_t spiBytes                = 0; // 上次报告以来渲染的帧的窗口字节数
 
 // 用于自主虹膜缩放
 #define  IRIS_LEVELS 7 // 虹膜级别
@@ -65,18 +72,78 @@ float    iris_prev[IRIS_LEVELS] = { 0 }; // 前一个虹膜值
 float    iris_next[IRIS_LEVELS] = { 0 }; // 下一个虹膜值
 uint16_t iris_frame = 0; // 虹膜帧
 
-// 在每个 SPI DMA 传输后调用的回调 - 设置一个标志，表示可以立即发出下一行图形。
+// 眼睛 'e' 的一个列结构已经发出（或 DMA 卡住后放弃）：它回到环中可以重新
+// 渲染，记录总线开始空闲的时间，并设置一个标志，表示可以发出下一列。
+static void columnDone(uint8_t e) {
+  __DMB(); // DMA 和此前对列结构的读取都在它回到环中（loop() 可能重新渲染）之前完成
+  eye[e].column[eye[e].colTail].ready = false;
+  if(++eye[e].colTail >= eye[e].numColumns) eye[e].colTail = 0;
+  eye[e].idleStart = micros();
+  eye[e].dma_busy  = false;
+}
+
+// 通过 SPI DMA 发出眼睛 'e' 的列结构 'c'（环中最早渲染的一个）。
+// 由 loop() 或 DMA 完成的中断调用。
+static void startColumn(uint8_t e, columnStruct *c) {
+  memcpy(eye[e].dptr, &c->descriptor[0], sizeof(DmacDescriptor));
+  eye[e].dma_busy      = true;
+  eye[e].idleTime     += micros() - eye[e].idleStart;
+  eye[e].dma.startJob();
+  eye[e].dmaStartTime  = micros();
+  eye[e].dmaPixels     = c->pixels;
+  dmaJobs++;
+  // 列结构在 DMA 完成时（columnDone()）回到环中
+}
+
+// 下一帧重新画出眼睛 'e' 的整个屏幕（见 frameWindow()）
+static void repaintAll(uint8_t e) {
+  eye[e].openX0 = eye[e].openY0 = 0;
+  eye[e].openX1 = eye[e].openY1 = DISPLAY_SIZE - 1;
+}
+
+// 在每个 SPI DMA 传输后调用的回调（在中断中）。如果下一列已经渲染，
+// 立即在这里发出，不等 loop() 回到这只眼睛（它可能正在渲染另一只眼睛
+// 的一列，或在 user_loop() 中），列之间的总线几乎没有空闲。新一帧的
+// 第一列留给 loop()：它需要先重新设置 SPI 事务和地址窗口。
 static void dma_callback(Adafruit_ZeroDMA *dma) {
   // 可以为每个 DMA 通道分配自己的回调函数（比这种通道到眼睛的查找方式节省一些周期），
   // 但这样编写是为了扩展到所需数量的眼睛（如果移植到 Grand Central 等设备，最多每个 SERCOM 一个）。
   for(uint8_t e=0; e<NUM_EYES; e++) {
     if(dma == &eye[e].dma) {
-      eye[e].dma_busy = false;
+      columnDone(e);
+      columnStruct *c = &eye[e].column[eye[e].colTail];
+      if(c->ready && !c->first) startColumn(e, c);
       return;
     }
   }
 }
 
+// 每列的描述符和像素的字节数（分配的列结构的大小是它的倍数）
+#define COLUMN_BYTES (NUM_DESCRIPTORS * sizeof(DmacDescriptor) + DISPLAY_SIZE * sizeof(uint16_t))
+// 'columns' 列的列结构分配的字节数。DMAC 要求描述符 16 字节对齐，
+// heapAlloc() 只保证 8 字节，多分配 8 字节以便把描述符移到对齐的位置
+#define SLOT_BYTES(columns) ((columns) * COLUMN_BYTES + 8)
+
+// 设置一个 'columns' 列的列结构，使用给定的描述符和像素缓冲区，
+// 并设置 DMA 描述符中不变的部分
+static void initColumn(columnStruct *c, uint8_t columns, DmacDescriptor *descriptor,
+  uint16_t *renderBuf, uint32_t spi_data_reg) {
+  c->descriptor = descriptor;
+  c->renderBuf  = renderBuf;
+  c->columns    = columns;
+  for(int j=0; j<columns*NUM_DESCRIPTORS; j++) { // 对于每列的每个描述符...
+    c->descriptor[j].BTCTRL.bit.VALID    = true; // 设置描述符有效
+    c->descriptor[j].BTCTRL.bit.EVOSEL   = DMA_EVENT_OUTPUT_DISABLE; // 禁用事件输出
+    c->descriptor[j].BTCTRL.bit.BLOCKACT = DMA_BLOCK_ACTION_NOACT; // 无块动作
+    c->descriptor[j].BTCTRL.bit.BEATSIZE = DMA_BEAT_SIZE_BYTE; // 字节大小
+    c->descriptor[j].BTCTRL.bit.DSTINC   = 0; // 目标地址不递增
+    c->descriptor[j].BTCTRL.bit.STEPSEL  = DMA_STEPSEL_SRC; // 源地址步进
+    c->descriptor[j].BTCTRL.bit.STEPSIZE = DMA_ADDRESS_INCREMENT_STEP_SIZE_1; // 步进大小为 1
+    c->descriptor[j].DSTADDR.reg         = spi_data_reg; // 目标地址为 SPI 数据寄存器
+  }
+  c->ready = false;
+}
+
 // >50MHz SPI 很有趣，但太不稳定，无法依赖
 //#if F_CPU < 200000000
 // #define DISPLAY_FREQ   (F_CPU / 2)
@@ -94,7 +161,14 @@ SPISettings settings(DISPLAY_FREQ, MSBFIRST, SPI_MODE0); // SPI 设置
 // 代码需要定期等待 DMA 传输完成，我们可以使用 micros() 函数来确定是否花费了
 // 比预期长得多的时间（使用 4 的因子 - 下面的“4000”，以允许缓存/调度余量）。
 // 如果是这样，那就是我们的信号，表明可能出了问题，我们采取规避措施，重置受影响的 DMA 通道（DMAbuddy::fix()）。
-#define DMA_TIMEOUT (uint32_t)((DISPLAY_SIZE * 16 * 4000) / (DISPLAY_FREQ / 1000))
+// 一次传输可以包括多列（最多 columnBatch 列），所以超时按传输的像素数
+// 计算，但不少于一整列的时间（小窗口的传输也有固定的开销）。
+#define DMA_TIMEOUT(pixels) (uint32_t)(((uint32_t)max((int)(pixels), DISPLAY_SIZE) * 16 * 4000) / \
+  (DISPLAY_FREQ / 1000))
+
+// 每帧读取触摸传感器的次数（在最后一只眼睛的第一列之前一起读取，见
+// loop()），setup() 中校准 boopThreshold 时也读取这么多次
+#define BOOP_READS 16
 
 // 读取触摸传感器的值
 static inline uint16_t readBoop(void) {
@@ -124,6 +198,22 @@ uint32_t availableRAM(void) {
   return &top - (char *)sbrk(0); // 堆栈顶部减去堆的末尾
 }
 
+#if defined(FIXED_TABLES)
+// 如果几何参数与 fixedtables.h 生成时相同，让表指向闪存中的 const 数组
+// 并返回 true。否则（配置文件已更改）返回 false，调用者在运行时生成表。
+static bool useFixedTables(eyeTables *t) {
+  if((t->displaySize     != FIXED_DISPLAY_SIZE)      ||
+     (t->eyeRadius       != FIXED_EYE_RADIUS)        ||
+     (t->irisRadius      != FIXED_IRIS_RADIUS)       ||
+     (t->slitPupilRadius != FIXED_SLIT_PUPIL_RADIUS) ||
+     (t->mapRadius       != FIXED_MAP_RADIUS)) return false;
+  t->displace = fixedDisplace;
+  t->polar    = fixedPolar;
+  t->octant   = FIXED_OCTANT;
+  return true;
+}
+#endif
+
 // SETUP 函数 - 在程序启动时调用一次 ---------------------------
 
 void setup() {
@@ -147,7 +237,8 @@ void setup() {
   //while(!Serial) yield();
 
   Serial.printf("启动时可用 RAM: %d\n", availableRAM()); // 打印可用 RAM
-  Serial.printf("启动时可用闪存: %d\n", arcada.availableFlash()); // 打印可用闪存
+  Serial.printf("启动时可用闪存: %d\n", availableNVM()); // 打印可用闪存
+  heapReport("启动"); // 每个阶段之后报告堆，随时可在串口监视器中输入 h
   yield(); // 定期 yield() 确保大容量存储文件系统保持活动状态
 
   // 还没有文件选择器。在此期间，您可以通过在启动时按住三个边缘按钮之一来覆盖默认的
@@ -157,11 +248,12 @@ void setup() {
   char *filename = (char *)"config.eye";
  
   uint32_t buttonState = arcada.readButtons(); // 读取按钮状态
-  if((buttonState & ARCADA_BUTTONMASK_UP) && arcada.exists("config1.eye")) {
+  // （只有 config1.eyp 眼睛包也可以，见 eyepack.h）
+  if((buttonState & ARCADA_BUTTONMASK_UP) && presetExists((char *)"config1.eye")) {
     filename = (char *)"config1.eye"; // 如果按住上按钮且存在 config1.eye，则加载 config1.eye
-  } else if((buttonState & ARCADA_BUTTONMASK_A) && arcada.exists("config2.eye")) {
+  } else if((buttonState & ARCADA_BUTTONMASK_A) && presetExists((char *)"config2.eye")) {
     filename = (char *)"config2.eye"; // 如果按住 A 按钮且存在 config2.eye，则加载 config2.eye
-  } else if((buttonState & ARCADA_BUTTONMASK_DOWN) && arcada.exists("config3.eye")) {
+  } else if((buttonState & ARCADA_BUTTONMASK_DOWN) && presetExists((char *)"config3.eye")) {
     filename = (char *)"config3.eye"; // 如果按住下按钮且存在 config3.eye，则加载 config3.eye
   }
 
@@ -189,29 +281,30 @@ void setup() {
     eye[e].dma.setCallback(dma_callback); // 设置 DMA 回调
     eye[e].dma.setPriority(DMA_PRIORITY_0); // 设置 DMA 优先级
     uint32_t spi_data_reg = (uint32_t)eye[e].spi->getDataRegister(); // 获取 SPI 数据寄存器地址
-    for(int i=0; i<2; i++) {   // 对于每 2 行...
-      for(int j=0; j<NUM_DESCRIPTORS; j++) { // 对于每行的每个描述符...
-        eye[e].column[i].descriptor[j].BTCTRL.bit.VALID    = true; // 设置描述符有效
-        eye[e].column[i].descriptor[j].BTCTRL.bit.EVOSEL   = DMA_EVENT_OUTPUT_DISABLE; // 禁用事件输出
-        eye[e].column[i].descriptor[j].BTCTRL.bit.BLOCKACT = DMA_BLOCK_ACTION_NOACT; // 无块动作
-        eye[e].column[i].descriptor[j].BTCTRL.bit.BEATSIZE = DMA_BEAT_SIZE_BYTE; // 字节大小
-        eye[e].column[i].descriptor[j].BTCTRL.bit.DSTINC   = 0; // 目标地址不递增
-        eye[e].column[i].descriptor[j].BTCTRL.bit.STEPSEL  = DMA_STEPSEL_SRC; // 源地址步进
-        eye[e].column[i].descriptor[j].BTCTRL.bit.STEPSIZE = DMA_ADDRESS_INCREMENT_STEP_SIZE_1; // 步进大小为 1
-        eye[e].column[i].descriptor[j].DSTADDR.reg         = spi_data_reg; // 目标地址为 SPI 数据寄存器
-      }
+    for(int i=0; i<2; i++) {   // 静态的两个列结构，其余的在 setup() 结束时分配
+      initColumn(&eye[e].column[i], 1, eye[e].descriptorBuf[i], eye[e].pixelBuf[i], spi_data_reg);
     }
-    eye[e].colNum       = DISPLAY_SIZE; // 强制初始回绕到第一列
-    eye[e].colIdx       = 0;
+    eye[e].numColumns   = 2;
+    eye[e].colHead      = 0;
+    eye[e].colTail      = 0;
+    eye[e].colNum       = 0;
+    repaintAll(e);
     eye[e].dma_busy     = false;
-    eye[e].column_ready = false;
     eye[e].dmaStartTime = 0;
+    eye[e].dmaPixels    = 0;
+    eye[e].idleTime     = 0;
 
     // 可以在配置文件中覆盖的默认设置
     eye[e].pupilColor        = 0x0000; // 瞳孔颜色
     eye[e].backColor         = 0xFFFF; // 背景颜色
     eye[e].iris.color        = 0xFF01; // 虹膜颜色
     eye[e].iris.data         = NULL; // 虹膜数据
+    eye[e].iris.index        = NULL; // 虹膜索引（8 位索引纹理）
+    eye[e].iris.tileHeight   = 0;    // 虹膜逐行存储
+    eye[e].iris.rowOffset    = NULL;
+    eye[e].iris.colOffset    = NULL;
+    eye[e].iris.priority     = 2;    // 虹膜较小、采样较多，默认先放入快的存储器
+    eye[e].iris.tier         = TIER_NONE;
     eye[e].iris.filename     = NULL; // 虹膜文件名
     eye[e].iris.startAngle   = (e & 1) ? 512 : 0; // 交替眼睛旋转 180 度
     eye[e].iris.angle        = eye[e].iris.startAngle; // 虹膜角度
@@ -220,6 +313,12 @@ void setup() {
     eye[e].iris.iSpin        = 0; // 虹膜旋转增量
     eye[e].sclera.color      = 0xFFFF; // 巩膜颜色
     eye[e].sclera.data       = NULL; // 巩膜数据
+    eye[e].sclera.index      = NULL; // 巩膜索引（8 位索引纹理）
+    eye[e].sclera.tileHeight = 0;    // 巩膜逐行存储
+    eye[e].sclera.rowOffset  = NULL;
+    eye[e].sclera.colOffset  = NULL;
+    eye[e].sclera.priority   = 1;
+    eye[e].sclera.tier       = TIER_NONE;
     eye[e].sclera.filename   = NULL; // 巩膜文件名
     eye[e].sclera.startAngle = (e & 1) ? 512 : 0; // 交替眼睛旋转 180 度
     eye[e].sclera.angle      = eye[e].sclera.startAngle; // 巩膜角度
@@ -263,82 +362,52 @@ void setup() {
 
   // 加载配置文件 -----------------------------------------------
 
+  // 加载阶段（配置、纹理和眼睑）的临时内存都来自一个区域，加载结束时
+  // 一起释放，不在堆中留下碎片（见 memory.cpp）
+  // 与配置文件同名的眼睛包（.eyp）存在时，配置、纹理、眼睑和表都从
+  // 这一个文件读取（见 eyepack.h）
+  uint32_t loadStart = millis();
+  bool     packed    = packBegin(filename);
+  arenaBegin();
   loadConfig(filename);
 
   // 加载眼睑和纹理贴图 -----------------------------------------
 
-  // 在加载纹理贴图时遇到内存碎片问题。这些图像仅临时占用 RAM ——
-  // 它们被复制到内部闪存中，然后释放。然而，某些东西阻止了释放的内存
-  // 恢复到连续块。例如，如果加载了大约 50% RAM 的纹理图像/复制/释放，
-  // 随后加载更大的纹理（或尝试分配更大的极坐标查找数组）会失败，因为 RAM
-  // 被分成两个段。我已经仔细检查了这段代码、Adafruit_ImageReader 和 Adafruit_GFX，
-  // 它们似乎以与分配相反的顺序释放 RAM（这应该可以避免碎片），但我可能忽略了
-  // 那里的某些东西或其他库中的额外分配 —— 可能是文件系统和/或大容量存储代码。
-  // 所以，这里是肮脏的解决方法...
-  // Adafruit_ImageReader 提供了一个 bmpDimensions() 函数，用于确定图像的像素大小
-  // 而无需实际加载它。我们可以使用它来估计加载图像所需的 RAM，然后分配一个
-  // “助推器座位”，使后续的图像加载发生在更高的内存中，而碎片部分则稍微超出。
-  // 当图像和助推器都被释放时，应该会恢复一个大块的连续内存，将碎片留在高内存中。
-  // 但不要太高，我们需要为堆栈留出一些 RAM 以在此程序的整个生命周期内运行
-  // 并处理小的堆分配。
-
-  uint32_t maxRam = availableRAM() - stackReserve; // 最大可用 RAM
-
-  // 加载眼睛的纹理贴图
-  uint8_t e2;
-  for(e=0; e<NUM_EYES; e++) { // 对于每只眼睛...
+  // 按优先级顺序加载眼睛的纹理贴图，优先级高的先得到内部闪存（见 memory.cpp）
+  texture *textures[NUM_EYES * 2];
+  int      numTextures = texturesByPriority(textures);
+  for(int i=0; i<numTextures; i++) { // 对于每个纹理...
     yield();
-    for(e2=0; e2<e; e2++) {    // 与每只之前的眼睛比较...
-      // 如果两只眼睛有相同的虹膜文件名...
-      if((eye[e].iris.filename && eye[e2].iris.filename) &&
-         (!strcmp(eye[e].iris.filename, eye[e2].iris.filename))) {
-        // 那么眼睛 'e' 可以共享 'e2' 的虹膜图形
-        // 旋转和镜像保持独立，只共享图像
-        eye[e].iris.data   = eye[e2].iris.data;
-        eye[e].iris.width  = eye[e2].iris.width;
-        eye[e].iris.height = eye[e2].iris.height;
-        break;
-      }
-    }
-    if((!e) || (e2 >= e)) { // 如果是第一只眼睛，或未找到匹配项...
-      // 如果未指定虹膜文件名，或文件加载失败...
-      if((eye[e].iris.filename == NULL) || (loadTexture(eye[e].iris.filename,
-        &eye[e].iris.data, &eye[e].iris.width, &eye[e].iris.height,
-        maxRam) != IMAGE_SUCCESS)) {
-        // 将虹膜数据指向颜色变量并将图像大小设置为 1px
-        eye[e].iris.data  = &eye[e].iris.color;
-        eye[e].iris.width = eye[e].iris.height = 1;
-      }
-      // 助推器座位的想法仍然不总是有效，
-      // 高内存中有东西泄漏。每次加载纹理时，
-      // 逐渐缩小助推器座位的大小。唉。
-      maxRam -= 20;
-    }
-    // 重复巩膜...
-    for(e2=0; e2<e; e2++) {    // 与每只之前的眼睛比较...
-      // 如果两只眼睛有相同的巩膜文件名...
-      if((eye[e].sclera.filename && eye[e2].sclera.filename) &&
-         (!strcmp(eye[e].sclera.filename, eye[e2].sclera.filename))) {
-        // 那么眼睛 'e' 可以共享 'e2' 的巩膜图形
+    texture *t = textures[i];
+    int      j;
+    for(j=0; j<i; j++) {    // 与每个之前的纹理比较...
+      // 如果两个纹理有相同的文件名...
+      if((t->filename && textures[j]->filename) &&
+         (!strcmp(t->filename, textures[j]->filename))) {
+        // 那么可以共享之前的纹理图形
         // 旋转和镜像保持独立，只共享图像
-        eye[e].sclera.data   = eye[e2].sclera.data;
-        eye[e].sclera.width  = eye[e2].sclera.width;
-        eye[e].sclera.height = eye[e2].sclera.height;
+        t->data       = textures[j]->data;
+        t->index      = textures[j]->index;
+        t->tileHeight = textures[j]->tileHeight; // 地址表由 finishTextures() 共享
+        t->width      = textures[j]->width;
+        t->height     = textures[j]->height;
+        t->tier       = textures[j]->tier;
         break;
       }
     }
-    if((!e) || (e2 >= e)) { // 如果是第一只眼睛，或未找到匹配项...
-      // 如果未指定巩膜文件名，或文件加载失败...
-      if((eye[e].sclera.filename == NULL) || (loadTexture(eye[e].sclera.filename,
-        &eye[e].sclera.data, &eye[e].sclera.width, &eye[e].sclera.height,
-        maxRam) != IMAGE_SUCCESS)) {
-        // 将巩膜数据指向颜色变量并将图像大小设置为 1px
-        eye[e].sclera.data  = &eye[e].sclera.color;
-        eye[e].sclera.width = eye[e].sclera.height = 1;
+    if(j >= i) { // 如果是第一个纹理，或未找到匹配项...
+      // 如果未指定文件名，或文件加载失败...
+      if((t->filename == NULL) || (loadTexture(t->filename, t) != IMAGE_SUCCESS)) {
+        // 将纹理数据指向颜色变量并将图像大小设置为 1px
+        t->data  = &t->color;
+        t->index = NULL;
+        t->width = t->height = 1;
+        t->tier  = TIER_NONE;
       }
-      maxRam -= 20; // 参见上面的注释
     }
   }
+  Serial.printf("纹理闪存缓存：命中 %d，未命中 %d\n",
+    textureCacheHits, textureCacheMisses);
 
   // 加载眼睑图形。
   yield();
@@ -346,34 +415,83 @@ void setup() {
 
   status = loadEyelid(upperEyelidFilename ?
     upperEyelidFilename : (char *)"upper.bmp",
-    upperClosed, upperOpen, DISPLAY_SIZE-1, maxRam); // 加载上眼睑
+    upperClosed, upperOpen, DISPLAY_SIZE-1); // 加载上眼睑
 
   status = loadEyelid(lowerEyelidFilename ?
     lowerEyelidFilename : (char *)"lower.bmp",
-    lowerOpen, lowerClosed, 0, maxRam); // 加载下眼睑
+    lowerOpen, lowerClosed, 0); // 加载下眼睑
+
+  // 加载阶段结束，释放区域（包括文件名）
+  heapReport("加载");
+  arenaEnd();
+  for(e=0; e<NUM_EYES; e++) eye[e].iris.filename = eye[e].sclera.filename = NULL;
+  upperEyelidFilename = lowerEyelidFilename = NULL;
+
+  // 纹理常驻的 RAM（调色板、块布局的地址表）在区域释放之后分配
+  finishTextures();
 
-  // 不再需要文件名...
+  // 纹理现已确定，为每只眼睛选择专用的列渲染器
   for(e=0; e<NUM_EYES; e++) {
-    if(eye[e].sclera.filename) free(eye[e].sclera.filename);
-    if(eye[e].iris.filename)   free(eye[e].iris.filename);
+    prepareTexture(&eye[e].iris);
+    prepareTexture(&eye[e].sclera);
+    eye[e].renderer = selectRenderer(&eye[e].iris, &eye[e].sclera);
   }
-  if(lowerEyelidFilename) free(lowerEyelidFilename);
-  if(upperEyelidFilename) free(upperEyelidFilename);
 
-  // 此时调用 availableRAM() 将返回接近 reserveSpace 的值，表明可用 RAM 很少...
-  // 但该函数实际上只是返回堆和堆栈之间的空间，我们已经在上面确定了堆顶是某种海市蜃楼。
-  // 大块分配仍然可以在较低的堆中进行！
+  // 为每种不同的几何生成一组表（loadConfig() 已让几何相同的眼睛共享）。
+  for(e=0; e<NUM_EYES; e++) {
+    eyeTables *t = eye[e].tables;
+    if(t->polar) continue; // 与之前的眼睛共享，已经生成
+#if defined(FIXED_TABLES)
+    if(useFixedTables(t)) {
+      Serial.printf("眼睛 #%d 使用闪存中的固定表\n", e);
+      continue;
+    }
+    Serial.printf("眼睛 #%d 的几何与 fixedtables.h 不同，生成表\n", e);
+#endif
+    if(e) {
+      // 额外的一组表：先检查是否放得下（加上一些余量给以后的小分配），
+      // 否则退回使用第一只眼睛的表和几何。
+      if(!heapFits(tableSetSize(t) + stackReserve)) {
+        Serial.printf("眼睛 #%d 的表需要 %d 字节，RAM 不足，使用眼睛 #0 的几何\n",
+          e, tableSetSize(t));
+        eye[e].tables = eye[0].tables;
+        continue;
+      }
+    }
+    uint32_t tableStart = millis();
+    bool     cached     = loadTables(t); // 从文件系统缓存读取（如果几何匹配）
+    if(!cached) {
+      calcMap(t); // 计算地图
+      calcDisplacement(t); // 计算位移
+      saveTables(t); // 下次启动使用
+    }
+    Serial.printf("眼睛 #%d 表%s: %d 毫秒\n", e, cached ? "（缓存）" : "已生成",
+      (int)(millis() - tableStart));
+    Serial.printf("眼睛 #%d 极坐标地图: %d 字节（按整个象限存储为 %d 字节）\n",
+      e, polarMapSize(t, t->octant), polarMapSize(t, false));
+  }
+
+  packEnd();
+  Serial.printf("加载阶段（%s）: %d 毫秒\n", packed ? "眼睛包" : "单独的文件",
+    (int)(millis() - loadStart));
+  heapReport("表");
 
-  calcMap(); // 计算地图
-  calcDisplacement(); // 计算位移
+  // 表已经分配，剩余的 RAM 可以给纹理使用
+  placeTextures();
+  heapReport("纹理");
   Serial.printf("可用 RAM: %d\n", availableRAM()); // 打印可用 RAM
 
   randomSeed(SysTick->VAL + analogRead(A2)); // 随机种子
   eyeOldX = eyeNewX = eyeOldY = eyeNewY = mapRadius; // 从中心开始
   for(e=0; e<NUM_EYES; e++) { // 对于每只眼睛...
     eye[e].display->setRotation(eye[e].rotation); // 设置旋转
-    eye[e].eyeX = eyeOldX; // 设置初始位置
-    eye[e].eyeY = eyeOldY;
+    // 眼睛运动在全局几何的地图空间中计算（见 loop()），然后按眼跳范围的
+    // 比例缩放到每只眼睛自己的地图。
+    float r0 = (float)mapDiameter                - (float)DISPLAY_SIZE * M_PI_2,
+          r1 = (float)eye[e].tables->mapDiameter - (float)DISPLAY_SIZE * M_PI_2;
+    eye[e].mapScale = ((r0 > 0.0) && (r1 > 0.0)) ? (r1 / r0) :
+      ((float)eye[e].tables->mapRadius / (float)mapRadius);
+    eye[e].eyeX = eye[e].eyeY = eye[e].tables->mapRadius; // 设置初始位置
   }
 
   if (showSplashScreen) { // 上面加载了图像？
@@ -404,21 +522,52 @@ void setup() {
       if(waveform) voiceMod(modulate, waveform); // 设置语音调制
       arcada.enableSpeaker(true); // 启用扬声器
     }
+    heapReport("语音");
   }
 #endif
 
+  // 列环形缓冲区：其他分配都完成之后，RAM 允许时每只眼睛再加几个列结构
+  // （两只眼睛轮流分配，深度相同），仍然保留 stackReserve。每个 K 列，
+  // K 是所有列结构在最大的空闲块中放得下的最大值；只剩一列的 RAM 时
+  // 与静态的列结构相同。
+  uint8_t batch = columnBatch;
+  while((batch > 1) && !heapFits((columnRing - 2) * NUM_EYES * SLOT_BYTES(batch) + stackReserve)) {
+    batch--;
+  }
+  for(uint8_t n=2; n<columnRing; n++) {
+    for(e=0; e<NUM_EYES; e++) {
+      uint8_t *mem = NULL;
+      if(heapFits(SLOT_BYTES(batch) + stackReserve)) {
+        mem = (uint8_t *)heapAlloc(HEAP_COLUMNS, SLOT_BYTES(batch));
+      }
+      if(!mem) break;
+      // 描述符在前（向上对齐到 16 字节），然后是像素
+      mem = (uint8_t *)(((uintptr_t)mem + 15) & ~(uintptr_t)15);
+      initColumn(&eye[e].column[eye[e].numColumns++], batch, (DmacDescriptor *)mem,
+        (uint16_t *)(mem + batch * NUM_DESCRIPTORS * sizeof(DmacDescriptor)),
+        (uint32_t)eye[e].spi->getDataRegister());
+    }
+    if(e < NUM_EYES) break;
+  }
+  for(e=0; e<NUM_EYES; e++) {
+    Serial.printf("眼睛 #%d: %d 个列结构（2 个 1 列，%d 个 %d 列）\n", e,
+      eye[e].numColumns, eye[e].numColumns - 2, batch);
+  }
+  heapReport("列");
+
   arcada.setBacklight(255); // 背光重新打开，即将显示图形
 
   yield();
   if(boopPin >= 0) { // 如果启用了触摸传感器
     boopThreshold = 0;
-    for(int i=0; i<DISPLAY_SIZE; i++) {
+    for(int i=0; i<BOOP_READS; i++) {
       boopThreshold += readBoop(); // 读取触摸传感器值
     }
     boopThreshold = boopThreshold * 110 / 100; // 10% 余量
   }
 
   lastLightReadTime = micros() + 2000000; // 延迟初始光线读取
+  for(e=0; e<NUM_EYES; e++) eye[e].idleStart = micros();
 }
 
 
@@ -450,17 +599,138 @@ B) 每个屏幕现在都在自己的 SPI 总线上...数据可以并发发出...
 每个眼睛可以根据当前的特定复杂性以独立的帧速率运行）。
 */
 
-// loop() 函数处理一只眼睛的一列...
+// 眼睛 'e' 的列 'x' 中眼睑之间睁开的像素 *y1 到 *y2（包括两端）。
+// 如果此列没有眼睑数据（眼睑图像小于屏幕），或眼睑完全或部分闭合，
+// 足以使此列没有像素需要渲染，返回 false。
+static bool lidSpan(uint8_t e, int x, float upperLidFactor, float lowerLidFactor,
+  int *y1, int *y2) {
+  int lidColumn = (e & 1) ? (DISPLAY_SIZE - 1 - x) : x; // 左眼反转眼睑列
+  if(upperOpen[lidColumn] == 255) return false;
+  *y1 = lowerClosed[lidColumn] + (int)(0.5 + lowerLidFactor *
+    (float)((int)lowerOpen[lidColumn] - (int)lowerClosed[lidColumn]));
+  *y2 = upperClosed[lidColumn] + (int)(0.5 + upperLidFactor *
+    (float)((int)upperOpen[lidColumn] - (int)upperClosed[lidColumn]));
+  if(*y1 > DISPLAY_SIZE-1)    *y1 = DISPLAY_SIZE-1; // 如果 lidfactor 超出通常的 0.0 到 1.0 范围，则剪裁结果
+  else if(*y1 < 0) *y1 = 0;   // 
+  if(*y2 > DISPLAY_SIZE-1)    *y2 = DISPLAY_SIZE-1;
+  else if(*y2 < 0) *y2 = 0;
+  return *y1 < *y2;
+}
+
+// 在帧开始时设置眼睛 'e' 这一帧的窗口：睁开部分的外接矩形，与上一帧的
+// 合并，这样上一帧睁开、这一帧被眼睑盖住的像素画一次眼睑颜色，然后
+// 不再发出。眼睛完全闭合并且上一帧也是时，窗口是一个（眼睑颜色的）
+// 像素，帧仍然照常开始和结束。
+static void frameWindow(uint8_t e, float upperLidFactor, float lowerLidFactor) {
+  int x0 = DISPLAY_SIZE, x1 = -1, y0 = DISPLAY_SIZE, y1 = -1, top, bottom;
+  for(int x=0; x<DISPLAY_SIZE; x++) {
+    if(lidSpan(e, x, upperLidFactor, lowerLidFactor, &top, &bottom)) {
+      if(x < x0) x0 = x;
+      x1 = x;
+      if(top    < y0) y0 = top;
+      if(bottom > y1) y1 = bottom;
+    }
+  }
+  int wx0 = min(x0, (int)eye[e].openX0), wx1 = max(x1, (int)eye[e].openX1),
+      wy0 = min(y0, (int)eye[e].openY0), wy1 = max(y1, (int)eye[e].openY1);
+  if(wx0 > wx1) wx0 = wx1 = wy0 = wy1 = 0;
+  eye[e].winX   = wx0;
+  eye[e].winY   = wy0;
+  eye[e].winW   = wx1 - wx0 + 1;
+  eye[e].winH   = wy1 - wy0 + 1;
+  eye[e].openX0 = x0;
+  eye[e].openX1 = x1;
+  eye[e].openY0 = y0;
+  eye[e].openY1 = y1;
+}
+
+#if NUM_DESCRIPTORS > 1
+// 填写描述符 'd'：'pixels' 个像素，从 'src' 开始递增（renderBuf 中渲染的
+// 像素），或者重复 'src' 处的一个字节（眼睑和纯色段），并链接到下一个
+// 描述符。返回下一个描述符。
+static DmacDescriptor *addSpan(DmacDescriptor *d, bool inc, const void *src, int pixels) {
+  d->BTCTRL.bit.SRCINC = inc;
+  d->BTCNT.reg         = pixels * 2;
+  d->SRCADDR.reg       = (uint32_t)src + (inc ? pixels * 2 : 0); // 递增时指向数据末尾！
+  d->DESCADDR.reg      = (uint32_t)(d + 1);
+  return d + 1;
+}
+#endif
+
+// 将眼睛 'e' 的列 'x' 中窗口内的像素（winY 开始的 winH 个）渲染到
+// 'buf'。在 MONSTER M4SK 上这些像素都写入 'buf'，包括眼睑，列结构的
+// 描述符由 loop() 设置。在 HalloWing 上从 'd' 开始填写此列的描述符
+// （眼睑和渲染器报告的纯色段从颜色的一个字节发出，不写入 'buf'），
+// 返回最后一个，loop() 把它链接到下一列。
+static DmacDescriptor *renderColumn(uint8_t e, int x, float upperLidFactor,
+  float lowerLidFactor, const eyeRenderState *state, uint16_t *buf, DmacDescriptor *d) {
+  int y1, y2, ymin = eye[e].winY, ymax = ymin + eye[e].winH - 1;
+
+  // 睁开的像素总是在窗口内（见 frameWindow()）
+  if(!lidSpan(e, x, upperLidFactor, lowerLidFactor, &y1, &y2)) {
+    // 没有像素需要渲染，制作一整列空白：
+#if NUM_DESCRIPTORS > 1
+    d = addSpan(d, false, &eyelidIndex, ymax - ymin + 1) - 1;
+    d->DESCADDR.reg = 0; // 无链接描述符
+#else
+    for(int y=ymin; y<=ymax; y++) *buf++ = eyelidColor;
+#endif
+    return d;
+  }
+
+#if NUM_DESCRIPTORS > 1
+  // 单眼，根据需要动态构建描述符列表：上眼睑（除非在窗口顶部），
+  // 渲染的像素和纯色段交替，然后是下眼睑（除非在窗口底部）
+  if(y1 > ymin) d = addSpan(d, false, &eyelidIndex, y1 - ymin);
+  eye[e].renderer(eye[e].tables, state, x, y1, y2, buf);
+  int y = y1; // 下一个要发出的像素
+  for(int i=0; i<state->runs->count; i++) {
+    const colorRun *r = &state->runs->run[i];
+    if(r->y > y) d = addSpan(d, true, buf + (y - y1), r->y - y);
+    // 颜色的两个字节相同（见 render.h），从眼睛结构中的颜色发出
+    d = addSpan(d, false, (r->kind == RUN_PUPIL) ? (const void *)&eye[e].pupilColor :
+                          (r->kind == RUN_BACK ) ? (const void *)&eye[e].backColor  :
+                                                   (const void *)&eyelidIndex, r->count);
+    y = r->y + r->count;
+  }
+  if(y <= y2)   d = addSpan(d, true, buf + (y - y1), y2 - y + 1);
+  if(y2 < ymax) d = addSpan(d, false, &eyelidIndex, ymax - y2);
+  d--;
+  d->DESCADDR.reg = 0; // 描述符列表结束
+#else
+  // 完全缓冲此列：如果需要，渲染下眼睑
+  uint16_t *ptr = buf;
+  for(int y=ymin; y<y1; y++) *ptr++ = eyelidColor;
+
+  eye[e].renderer(eye[e].tables, state, x, y1, y2, ptr);
+
+  // 如果需要，渲染上眼睑
+  ptr += y2 - y1 + 1;
+  for(int y=y2+1; y<=ymax; y++) *ptr++ = eyelidColor;
+#endif
+  return d;
+}
+
+// loop() 函数处理一只眼睛：如果环中有空的列结构，渲染下几列（列结构
+// 的容量）。渲染可以领先发出最多 numColumns 个列结构。发出通常由 DMA 完成的中断接续
+// （dma_callback()）；loop() 只在 DMA 空闲时发出：新一帧的第一列，或者
+// 渲染落后、中断找不到已渲染的列时。
 
 void loop() {
   if(++eyeNum >= NUM_EYES) eyeNum = 0; // 循环处理眼睛...
 
-  uint8_t  x = eye[eyeNum].colNum;
-  uint32_t t = micros();
+  // loop() 的两次调用之间（yield() 中的 USB 大容量存储）或上一次调用中的
+  // user_loop() 可能访问了文件系统，渲染之前恢复 QSPI 的内存映射读取
+  qspiMapTextures();
 
-  // 如果此眼睛的下一列尚未渲染...
-  if(!eye[eyeNum].column_ready) {
-    if(!x) { // 如果是第一列...
+  uint8_t       x = eye[eyeNum].colNum;
+  uint32_t      t = micros();
+  columnStruct *c = &eye[eyeNum].column[eye[eyeNum].colHead];
+
+  // 如果环中的下一个列结构是空的（不在等待或正在发出）...
+  if(!c->ready) {
+    bool first = !x;
+    if(first) { // 如果是第一列...
 
       // 每帧眼睛动画逻辑发生在这里 -------------------
 
@@ -533,11 +803,13 @@ void loop() {
       // 将眼睛位置保存到此眼睛的结构中，以便在整个渲染过程中保持一致
       if(eyeNum & 1) eyeX += fixate; // 眼睛稍微向中心汇聚
       else           eyeX -= fixate;
-      eye[eyeNum].eyeX = eyeX;
-      eye[eyeNum].eyeY = eyeY;
+      eye[eyeNum].eyeX = eye[eyeNum].tables->mapRadius + (eyeX - mapRadius) * eye[eyeNum].mapScale;
+      eye[eyeNum].eyeY = eye[eyeNum].tables->mapRadius + (eyeY - mapRadius) * eye[eyeNum].mapScale;
 
       // pupilFactor? irisValue? 待办事项：选择一个名称并坚持使用
       eye[eyeNum].pupilFactor = irisValue;
+      // 虹膜纹理 Y 缩放在整帧中不变，在这里计算一次（而不是每列一次浮点除法）
+      eye[eyeNum].iPupilFactor = (int)((float)eye[eyeNum].iris.height * 256 * (1.0 / eye[eyeNum].pupilFactor));
       // 还要注意 - irisValue 在此函数的末尾为下一帧计算
       // （因为必须在没有 SPI 通信到左眼时读取传感器）
 
@@ -560,9 +832,10 @@ void loop() {
       float uq, lq; // 这里有很多草率的临时变量，抱歉
       if(tracking) {
         // 眼睑自然“跟踪”瞳孔（自动上下移动）
-        int ix = (int)map2screen(mapRadius - eye[eyeNum].eyeX) + (DISPLAY_SIZE/2), // 瞳孔位置
-            iy = (int)map2screen(mapRadius - eye[eyeNum].eyeY) + (DISPLAY_SIZE/2); // 在屏幕上
-        iy += irisRadius * trackFactor;
+        const eyeTables *et = eye[eyeNum].tables;
+        int ix = (int)map2screen(et, et->mapRadius - eye[eyeNum].eyeX) + (DISPLAY_SIZE/2), // 瞳孔位置
+            iy = (int)map2screen(et, et->mapRadius - eye[eyeNum].eyeY) + (DISPLAY_SIZE/2); // 在屏幕上
+        iy += et->irisRadius * trackFactor;
         if(eyeNum & 1) ix = DISPLAY_SIZE - 1 - ix; // 右眼翻转
         if(iy > upperOpen[ix]) {
           uq = 1.0;
@@ -611,21 +884,44 @@ void loop() {
       frames++;
       if(((t - lastFrameRateReportTime) >= 1000000) && t) { // 每秒一次。
         Serial.println((frames * 1000) / (t / 1000));
+        // 以及每条 SPI 总线在这段时间内空闲（没有 DMA 传输）的比例
+        Serial.print("SPI 空闲 %:");
+        for(uint8_t e=0; e<NUM_EYES; e++) {
+          Serial.printf(" %d", (int)((uint64_t)eye[e].idleTime * 100 / (t - lastFrameRateReportTime)));
+          eye[e].idleTime = 0;
+        }
+        Serial.println();
+        // 每个眼球帧的渲染 CPU 时间和 DMA 作业数（columnBatch 1 时与每列
+        // 一个作业相同，可以比较）
+        uint32_t f = frames - reportFrames;
+        if(f) Serial.printf("渲染 %d 微秒/帧，%d 个 DMA 作业/帧，%d 字节/帧\n",
+          (int)(renderTime / f), (int)(dmaJobs / f), (int)(spiBytes / f));
+        renderTime   = 0;
+        dmaJobs      = 0;
+        spiBytes     = 0;
+        reportFrames = frames;
         lastFrameRateReportTime = t;
       }
 
       // 每帧（眼睛 #0）重置 boopSum...
       if((eyeNum == 0) && (boopPin >= 0)) {
-        boopSumFiltered = ((boopSumFiltered * 3) + boopSum) / 4;
-        if(boopSumFiltered > boopThreshold) {
-          if(!booped) {
-            Serial.println("BOOP!");
+        // 每组是 BOOP_READS 次读取的总和，与 setup() 中的 boopThreshold
+        // 相同。列环可能使一帧的读取落在这里之前或之后，所以取平均；
+        // 还没有读取时保持上一帧的状态。
+        if(boopCount) {
+          boopSum         = boopSum / boopCount;
+          boopSumFiltered = ((boopSumFiltered * 3) + boopSum) / 4;
+          if(boopSumFiltered > boopThreshold) {
+            if(!booped) {
+              Serial.println("BOOP!");
+            }
+            booped = true;
+          } else {
+            booped = false;
           }
-          booped = true;
-        } else {
-          booped = false;
+          boopSum   = 0;
+          boopCount = 0;
         }
-        boopSum = 0;
       }
 
       float mins = (float)millis() / 60000.0;
@@ -656,191 +952,75 @@ void loop() {
     // 这些在帧之间是恒定的，可以存储在眼睛结构中
     float upperLidFactor = (1.0 - eye[eyeNum].blinkFactor) * eye[eyeNum].upperLidFactor,
           lowerLidFactor = (1.0 - eye[eyeNum].blinkFactor) * eye[eyeNum].lowerLidFactor;
-    iPupilFactor = (int)((float)eye[eyeNum].iris.height * 256 * (1.0 / eye[eyeNum].pupilFactor));
 
-    int y1, y2;
-    int lidColumn = (eyeNum & 1) ? (DISPLAY_SIZE - 1 - x) : x; // 左眼反转眼睑列
-
-    DmacDescriptor *d = &eye[eyeNum].column[eye[eyeNum].colIdx].descriptor[0];
+    if(first) { // 眼睑的位置已经更新，设置此帧的窗口，从它的第一列开始
+      frameWindow(eyeNum, upperLidFactor, lowerLidFactor);
+      x         = eye[eyeNum].winX;
+      spiBytes += eye[eyeNum].winW * eye[eyeNum].winH * 2;
+    }
 
-    if(upperOpen[lidColumn] == 255) {
-      // 此行没有眼睑数据；眼睑图像小于屏幕。
-      // 太好了！制作一整行空白，无需渲染：
-      d->BTCTRL.bit.SRCINC = 0;
-      d->BTCNT.reg         = DISPLAY_SIZE * 2;
-      d->SRCADDR.reg       = (uint32_t)&eyelidIndex;
-      d->DESCADDR.reg      = 0; // 无链接描述符
-    } else {
-      y1 = lowerClosed[lidColumn] + (int)(0.5 + lowerLidFactor *
-        (float)((int)lowerOpen[lidColumn] - (int)lowerClosed[lidColumn]));
-      y2 = upperClosed[lidColumn] + (int)(0.5 + upperLidFactor *
-        (float)((int)upperOpen[lidColumn] - (int)upperClosed[lidColumn]));
-      if(y1 > DISPLAY_SIZE-1)    y1 = DISPLAY_SIZE-1; // 如果 lidfactor 超出通常的 0.0 到 1.0 范围，则剪裁结果
-      else if(y1 < 0) y1 = 0;   // 
-      if(y2 > DISPLAY_SIZE-1)    y2 = DISPLAY_SIZE-1;
-      else if(y2 < 0) y2 = 0;
-      if(y1 >= y2) {
-        // 眼睑完全或部分闭合，足以使此行没有像素需要渲染。如上所述，制作“空白”。
-        d->BTCTRL.bit.SRCINC = 0;
-        d->BTCNT.reg         = DISPLAY_SIZE * 2;
-        d->SRCADDR.reg       = (uint32_t)&eyelidIndex;
-        d->DESCADDR.reg      = 0; // 无链接描述符
-      } else {
-        // 如果单眼，根据需要动态构建描述符列表，
-        // 否则使用单个描述符并完全缓冲每行。
+    // 睁开的眼睛部分由 render.cpp 渲染，状态在整个列结构中不变
+    eyeRenderState state;
+    state.xPosition    = xPositionOverMap;
+    state.yPosition    = yPositionOverMap;
+    state.iPupilFactor = eye[eyeNum].iPupilFactor;
+    state.pupilColor   = eye[eyeNum].pupilColor;
+    state.backColor    = eye[eyeNum].backColor;
+    state.eyelidColor  = eyelidColor;
+    state.iris         = &eye[eyeNum].iris;
+    state.sclera       = &eye[eyeNum].sclera;
 #if NUM_DESCRIPTORS > 1
-        DmacDescriptor *next;
-        int             renderlen;
-        if(y1 > 0) { // 除非在图像顶部，否则执行上眼睑
-          d->BTCTRL.bit.SRCINC = 0;
-          d->BTCNT.reg         = y1 * 2;
-          d->SRCADDR.reg       = (uint32_t)&eyelidIndex;
-          next                 = &eye[eyeNum].column[eye[eyeNum].colIdx].descriptor[1];
-          d->DESCADDR.reg      = (uint32_t)next; // 链接到下一个描述符
-          d                    = next;           // 前进到下一个描述符
-        }
-        // 将渲染部分列
-        renderlen            = y2 - y1 + 1;
-        d->BTCTRL.bit.SRCINC = 1;
-        d->BTCNT.reg         = renderlen * 2;
-        d->SRCADDR.reg       = (uint32_t)eye[eyeNum].column[eye[eyeNum].colIdx].renderBuf + renderlen * 2; // 指向数据末尾！
+    colorRuns runs;              // 每列由渲染器填写，见 renderColumn()
+    state.runs         = &runs;
+    state.pupilRuns    = pupilRuns;
 #else
-        // 将渲染整列；DISPLAY_SIZE 像素，将源指向 renderBuf 的末尾并启用源递增。
-        d->BTCTRL.bit.SRCINC = 1;
-        d->BTCNT.reg         = DISPLAY_SIZE * 2;
-        d->SRCADDR.reg       = (uint32_t)eye[eyeNum].column[eye[eyeNum].colIdx].renderBuf + DISPLAY_SIZE * 2;
-        d->DESCADDR.reg      = 0; // 无链接描述符
+    state.runs         = NULL;   // 像素都写入 renderBuf
+    state.pupilRuns    = false;
 #endif
-        // 将列 'x' 渲染到眼睛的下一个可用 renderBuf 中
-        uint16_t *ptr = eye[eyeNum].column[eye[eyeNum].colIdx].renderBuf;
-        int xx = xPositionOverMap + x;
-        int y;
 
-#if NUM_DESCRIPTORS == 1
-        // 如果需要，渲染下眼睑
-        for(y=0; y<y1; y++) *ptr++ = eyelidColor;
-#else
-        y = y1;
+    // 渲染从 x 开始的相邻列，直到列结构满了或到达窗口的最后一列
+    uint8_t         n = min((int)c->columns, eye[eyeNum].winX + eye[eyeNum].winW - x),
+                    h = eye[eyeNum].winH; // 每列的像素数
+    DmacDescriptor *d = c->descriptor;
+    for(uint8_t i=0; i<n; i++) {
+      d = renderColumn(eyeNum, x + i, upperLidFactor, lowerLidFactor, &state,
+        c->renderBuf + i * h, d);
+#if NUM_DESCRIPTORS > 1
+      if(i < (n - 1)) { // 链接到下一列的描述符
+        d->DESCADDR.reg = (uint32_t)(d + 1);
+        d++;
+      }
 #endif
-
-        // tablegen.cpp 解释了一些位移映射技巧。
-        uint8_t *displaceX, *displaceY;
-        int8_t   xmul; // X 位移的符号：+1 或 -1
-        int      doff; // 位移数组中的偏移量
-        if(x < (DISPLAY_SIZE/2)) {  // 屏幕的左半部分（象限 2, 3）
-          displaceX = &displace[ (DISPLAY_SIZE/2 - 1) - x       ];
-          displaceY = &displace[((DISPLAY_SIZE/2 - 1) - x) * (DISPLAY_SIZE/2)];
-          xmul      = -1; // X 位移始终为负
-        } else {       // 屏幕的右半部分（象限 1, 4）
-          displaceX = &displace[ x - (DISPLAY_SIZE/2)       ];
-          displaceY = &displace[(x - (DISPLAY_SIZE/2)) * (DISPLAY_SIZE/2)];
-          xmul      =  1; // X 位移始终为正
-        }
-
-        for(; y<=y2; y++) { // 对于此列中每只睁开的眼睛的每个像素...
-          int yy = yPositionOverMap + y;
-          int dx, dy;
-
-          if(y < (DISPLAY_SIZE/2)) { // 屏幕的下半部分（象限 3, 4）
-            doff = (DISPLAY_SIZE/2 - 1) - y;
-            dy   = -displaceY[doff];
-          } else {      // 屏幕的上半部分（象限 1, 2）
-            doff = y - (DISPLAY_SIZE/2);
-            dy   =  displaceY[doff];
-          }
-          dx = displaceX[doff * (DISPLAY_SIZE/2)];
-          if(dx < 255) {      // 在眼球区域内
-            dx *= xmul;       // 如果在象限 2 或 3 中，翻转 x 偏移的符号
-            int mx = xx + dx; // 极角/距离地图坐标
-            int my = yy + dy;
-            if((mx >= 0) && (mx < mapDiameter) && (my >= 0) && (my < mapDiameter)) {
-              // 在极角/距离地图内
-              int angle, dist, moff;
-              if(my >= mapRadius) {
-                if(mx >= mapRadius) { // 象限 1
-                  // 直接使用角度和距离
-                  mx   -= mapRadius;
-                  my   -= mapRadius;
-                  moff  = my * mapRadius + mx; // 地图数组中的偏移量
-                  angle = polarAngle[moff];
-                  dist  = polarDist[moff];
-                } else {                // 象限 2
-                  // 将角度旋转 90 度（顺时针 270 度；768）
-                  // 在 X 轴上镜像距离
-                  mx    = mapRadius - 1 - mx;
-                  my   -= mapRadius;
-                  angle = polarAngle[mx * mapRadius + my] + 768;
-                  dist  = polarDist[ my * mapRadius + mx];
-                }
-              } else {
-                if(mx < mapRadius) {  // 象限 3
-                  // 将角度旋转 180 度
-                  // 在 X 和 Y 轴上镜像距离
-                  mx    = mapRadius - 1 - mx;
-                  my    = mapRadius - 1 - my;
-                  moff  = my * mapRadius + mx;
-                  angle = polarAngle[moff] + 512;
-                  dist  = polarDist[ moff];
-                } else {                // 象限 4
-                  // 将角度旋转 270 度（顺时针 90 度；256）
-                  // 在 Y 轴上镜像距离
-                  mx   -= mapRadius;
-                  my    = mapRadius - 1 - my;
-                  angle = polarAngle[mx * mapRadius + my] + 256;
-                  dist  = polarDist[ my * mapRadius + mx];
-                }
-              }
-              // 将角度/距离转换为纹理贴图坐标
-              if(dist >= 0) { // 巩膜
-                angle = ((angle + eye[eyeNum].sclera.angle) & 1023) ^ eye[eyeNum].sclera.mirror;
-                int tx = angle * eye[eyeNum].sclera.width  / 1024; // 纹理贴图 x/y
-                int ty = dist  * eye[eyeNum].sclera.height / 128;
-                *ptr++ = eye[eyeNum].sclera.data[ty * eye[eyeNum].sclera.width + tx];
-              } else if(dist > -128) { // 虹膜或瞳孔
-                int ty = dist * iPupilFactor / -32768;
-                if(ty >= eye[eyeNum].iris.height) { // 瞳孔
-                  *ptr++ = eye[eyeNum].pupilColor;
-                } else { // 虹膜
-                  angle = ((angle + eye[eyeNum].iris.angle) & 1023) ^ eye[eyeNum].iris.mirror;
-                  int tx = angle * eye[eyeNum].iris.width / 1024;
-                  *ptr++ = eye[eyeNum].iris.data[ty * eye[eyeNum].iris.width + tx];
-                }
-              } else {
-                *ptr++ = eye[eyeNum].backColor; // 眼睛背面
-              }
-            } else {
-              *ptr++ = eye[eyeNum].backColor; // 超出地图，使用眼睛背面颜色
-            }
-          } else { // 超出眼球区域
-            *ptr++ = eyelidColor;
-          }
-        }
-
+    }
 #if NUM_DESCRIPTORS == 1
-        // 如果需要，渲染上眼睑
-        for(; y<DISPLAY_SIZE; y++) *ptr++ = eyelidColor;
-#else
-        if(y2 >= (DISPLAY_SIZE-1)) {
-          // 无第三个描述符；关闭它
-          d->DESCADDR.reg      = 0;
-        } else {
-          next                 = &eye[eyeNum].column[eye[eyeNum].colIdx].descriptor[(y1 > 0) ? 2 : 1];
-          d->DESCADDR.reg      = (uint32_t)next; // 链接到下一个描述符
-          d                    = next; // 递增描述符
-          d->BTCTRL.bit.SRCINC = 0;
-          d->BTCNT.reg         = ((DISPLAY_SIZE-1) - y2) * 2;
-          d->SRCADDR.reg       = (uint32_t)&eyelidIndex;
-          d->DESCADDR.reg      = 0; // 描述符列表结束
-        }
+    // 'n' 列的像素是连续的，一个描述符，将源指向 renderBuf 的末尾并启用源递增
+    d->BTCTRL.bit.SRCINC = 1;
+    d->BTCNT.reg         = n * h * 2;
+    d->SRCADDR.reg       = (uint32_t)(c->renderBuf + n * h);
+    d->DESCADDR.reg      = 0; // 无链接描述符
 #endif
-      }
+    c->x      = x;
+    c->first  = first;
+    c->winX   = eye[eyeNum].winX;
+    c->winY   = eye[eyeNum].winY;
+    c->winW   = eye[eyeNum].winW;
+    c->winH   = h;
+    c->pixels = n * h;
+    // 中断（dma_callback()）看到 ready 时读取 first 和 pixels：屏障使上面的
+    // 写入不会被编译器移到 ready 之后（volatile 写入不阻止普通写入移动）
+    __DMB();
+    c->ready  = true; // 列已渲染！
+    if(++eye[eyeNum].colHead >= eye[eyeNum].numColumns) eye[eyeNum].colHead = 0;
+    eye[eyeNum].colNum = x + n;
+    if(eye[eyeNum].colNum >= (eye[eyeNum].winX + eye[eyeNum].winW)) {
+      eye[eyeNum].colNum = 0; // 窗口的最后一列之后开始新的一帧
     }
-    eye[eyeNum].column_ready = true; // 行已渲染！
+    renderTime += micros() - t;
   }
 
-  // 如果此眼睛的 DMA 当前繁忙，不要阻塞，尝试下一只眼睛...
+  // 如果此眼睛的 DMA 当前繁忙（通常如此，中断接续发出），不要阻塞，尝试下一只眼睛...
   if(eye[eyeNum].dma_busy) {
-    if((micros() - eye[eyeNum].dmaStartTime) < DMA_TIMEOUT) return;
+    if((micros() - eye[eyeNum].dmaStartTime) < DMA_TIMEOUT(eye[eyeNum].dmaPixels)) return;
     // 如果我们到达代码中的这一点，SPI DMA 传输花费的时间明显长于预期，
     // 并且可能已卡住（请参阅 DMAbuddy.h 文件中的注释和此代码中 DMA_TIMEOUT 声明上方的注释）。
     // 采取行动！
@@ -851,17 +1031,23 @@ void loop() {
     // 即完全从头重新启动草图，尽管这会在启动期间使动画停滞几秒钟。
     // 除非 fix() 函数无法修复，否则不要启用此行！
     //NVIC_SystemReset();
+    columnDone(eyeNum); // 放弃卡住的列
+    repaintAll(eyeNum); // 屏幕上可能缺少一部分，下一帧重画
   }
 
-  // 此时，上述检查确认列已准备好且 DMA 空闲
-  if(!x) { // 如果是第一列...
+  // DMA 空闲，发出环中最早渲染的列（如果有）
+  c = &eye[eyeNum].column[eye[eyeNum].colTail];
+  if(!c->ready) return;
+  if(c->first) { // 如果是第一列...
     // 结束先前的 SPI 事务...
     digitalWrite(eye[eyeNum].cs, HIGH); // 取消选择
     eye[eyeNum].spi->endTransaction();
     // 初始化新的 SPI 事务和地址窗口...
     eye[eyeNum].spi->beginTransaction(settings);
     digitalWrite(eye[eyeNum].cs, LOW);  // 芯片选择
-    eye[eyeNum].display->setAddrWindow((eye[eyeNum].display->width() - DISPLAY_SIZE) / 2, (eye[eyeNum].display->height() - DISPLAY_SIZE) / 2, DISPLAY_SIZE, DISPLAY_SIZE);
+    // 每列是显示上的一行：窗口的 x 是列中的像素，y 是列
+    eye[eyeNum].display->setAddrWindow((eye[eyeNum].display->width() - DISPLAY_SIZE) / 2 + c->winY,
+      (eye[eyeNum].display->height() - DISPLAY_SIZE) / 2 + c->winX, c->winH, c->winW);
     delayMicroseconds(1);
     digitalWrite(eye[eyeNum].dc, HIGH); // 数据模式
     if(eyeNum == (NUM_EYES-1)) {
@@ -931,21 +1117,21 @@ void loop() {
       }
 #endif
       user_loop();
+      // 串口收到 'h' 时报告堆；只取走这个字节，其他输入留给 user_loop()
+      if(Serial.peek() == 'h') {
+        Serial.read();
+        heapReport("请求");
+      }
     }
   } // 结束第一列检查
 
-  // 必须在没有 SPI 通信穿过鼻子时读取触摸传感器！
-  if((eyeNum == (NUM_EYES-1)) && (boopPin >= 0)) {
-    boopSum += readBoop();
+  // 必须在没有 SPI 通信穿过鼻子时读取触摸传感器！中断接续发出的列
+  // 之间没有机会，所以每帧在第一列之前一起读取 BOOP_READS 次（次数
+  // 固定，与校准相同，不随 loop() 发出的列数变化）
+  if(c->first && (eyeNum == (NUM_EYES-1)) && (boopPin >= 0)) {
+    for(int i=0; i<BOOP_READS; i++) boopSum += readBoop();
+    boopCount++;
   }
 
-  memcpy(eye[eyeNum].dptr, &eye[eyeNum].column[eye[eyeNum].colIdx].descriptor[0], sizeof(DmacDescriptor));
-  eye[eyeNum].dma_busy       = true;
-  eye[eyeNum].dma.startJob();
-  eye[eyeNum].dmaStartTime   = micros();
-  if(++eye[eyeNum].colNum >= DISPLAY_SIZE) { // 如果最后一行已发送...
-    eye[eyeNum].colNum      = 0;    // 回绕到开头
-  }
-  eye[eyeNum].colIdx       ^= 1;    // 交替 0/1 行结构
-  eye[eyeNum].column_ready = false; // 可以渲染下一行
+  startColumn(eyeNum, c);
 }
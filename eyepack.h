@@ -0,0 +1,87 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 眼睛包（.eyp）文件格式。一个预设原本是 config.eye 加上几个 BMP，启动时
+// 逐个打开、解析文件头、逐行转换纹理和扫描眼睑。tools/eyepack 把一个预设
+// 编译成一个文件，每项资源都已经是固件使用的格式：纹理是 .tex（texfile.h），
+// 眼睑是已经算好的每列最小/最大值数组，还可以包括生成好的表。固件在
+// config.eye 旁边找到同名的 .eyp 文件时（例如 config1.eye 对应 config1.eyp），
+// 从包中读取这些资源（见 file.cpp），包中没有的资源仍然从单独的文件加载。
+//
+// 文件布局：一个 eyePackHeader，然后是 'entries' 个 eyePackEntry（目录），
+// 然后是各条目的数据。每个条目的数据从 EYEPACK_ALIGN 的倍数开始，与
+// 文件系统的扇区对齐，所以在 QSPI 闪存上连续存储的包可以直接映射（见
+// memory.cpp 中的 qspiAddress()）；条目按固件加载的顺序排列。
+// 所有多字节字段为小端。此头文件不依赖任何开发板专用的库，主机工具也
+// 使用它。
+
+#ifndef __EYEPACK_H
+#define __EYEPACK_H
+
+#include <stdint.h>
+#include "render.h" // eyeTables, TABLE_FORMAT
+
+#define EYEPACK_MAGIC   0x4B505945 // 文件以 "EYPK" 开头（按小端读取）
+#define EYEPACK_VERSION 1
+#define EYEPACK_ALIGN   512
+
+#define PACK_CONFIG  1 // config.eye 的文本（仍由 loadConfig() 解析）
+#define PACK_TEXTURE 2 // .tex 纹理；name = config.eye 中的纹理文件名
+#define PACK_EYELID  3 // 眼睑：DISPLAY_SIZE 字节的 minArray，然后是 maxArray
+                       // （与 loadEyelid() 的结果相同）；name = 眼睑文件名，
+                       // param = loadEyelid() 的 'init'
+#define PACK_TABLES  4 // 一组表，格式与表缓存文件相同（tableCacheHeader）；
+                       // key = tableKey()
+
+typedef struct {
+  uint32_t magic;       // EYEPACK_MAGIC
+  uint16_t version;     // EYEPACK_VERSION
+  uint16_t entries;     // 目录中的条目数
+  uint16_t displaySize; // 眼睑和表是为这个屏幕大小生成的
+  uint8_t  reserved[6]; // 0
+} eyePackHeader;        // 16 字节
+
+typedef struct {
+  uint32_t type;        // PACK_*
+  uint32_t offset;      // 数据在文件中的位置（EYEPACK_ALIGN 的倍数）
+  uint32_t bytes;       // 数据的字节数
+  uint32_t key;         // 纹理：数据的哈希（FNV-1a），代替 textureKey()
+                        // 读取整个文件；表：tableKey()
+  uint32_t param;       // 眼睑：见 PACK_EYELID
+  char     name[44];    // 以 0 结尾的文件名（纹理和眼睑）
+} eyePackEntry;         // 64 字节
+
+// 表缓存 ----------------------------------------------------------------
+
+// 表缓存文件（见 file.cpp）和 PACK_TABLES 条目的格式：一个
+// tableCacheHeader，然后是极坐标地图和位移映射。
+
+#define TABLE_CACHE_MAGIC 0x54455945 // 'EYET'，小端
+
+typedef struct {
+  uint32_t magic;
+  uint32_t key;           // tableKey()
+  uint32_t polarBytes;    // 之后是极坐标地图...
+  uint32_t displaceBytes; // ...然后是位移映射
+  uint8_t  octant;        // eyeTables.octant
+  uint8_t  reserved[3];
+} tableCacheHeader;
+
+// FNV-1a，从 'h' 继续
+static inline uint32_t eyePackHash(uint32_t h, const void *data, uint32_t bytes) {
+  const uint8_t *b = (const uint8_t *)data;
+  for(uint32_t i=0; i<bytes; i++) h = (h ^ b[i]) * 16777619u;
+  return h;
+}
+
+// 一组表的几何参数的哈希
+static inline uint32_t tableKey(const eyeTables *t) {
+  int32_t v[] = { TABLE_FORMAT, t->displaySize, t->eyeRadius, t->irisRadius,
+                  t->slitPupilRadius, t->mapRadius };
+  return eyePackHash(2166136261u, v, sizeof v);
+}
+
+#endif // __EYEPACK_H
@@ -10,6 +10,80 @@
 
 extern Adafruit_Arcada arcada;
 
+// 眼睛包 ----------------------------------------------------------------
+
+// 与配置文件同名的 .eyp 眼睛包（见 eyepack.h）存在时，loadConfig()、
+// loadTexture()、loadEyelid() 和 loadTables() 先在包中查找各自的资源，
+// 找不到才打开单独的文件。目录不保存在 RAM 中：每次查找从包的开头
+// 顺序读取目录（只有几个 64 字节的条目）。
+
+static char     packName[16] = ""; // 当前的眼睛包，空 = 没有
+static uint16_t packDisplaySize;   // 包中的眼睑和表是为这个屏幕大小生成的
+
+// 配置文件名对应的眼睛包文件名（扩展名换成 .eyp）
+static bool packNameFor(const char *configName, char *out) {
+  int len = strlen(configName);
+  if((len < 5) || (len >= (int)sizeof packName) || (configName[len - 4] != '.')) {
+    return false;
+  }
+  strcpy(out, configName);
+  strcpy(&out[len - 3], "eyp");
+  return true;
+}
+
+// 配置文件或同名的眼睛包是否存在
+bool presetExists(char *configName) {
+  char name[sizeof packName];
+  return arcada.exists(configName) ||
+    (packNameFor(configName, name) && arcada.exists(name));
+}
+
+// 如果与配置文件同名的眼睛包存在并且格式正确，之后的加载函数从中读取
+bool packBegin(char *configName) {
+  File          file;
+  eyePackHeader hdr;
+  char          name[sizeof packName];
+
+  packName[0] = 0;
+  if(!packNameFor(configName, name) || !(file = arcada.open(name, O_READ))) return false;
+  bool ok = (file.read(&hdr, sizeof hdr) == (int)sizeof hdr) &&
+            (hdr.magic == EYEPACK_MAGIC) && (hdr.version == EYEPACK_VERSION);
+  file.close();
+  if(ok) {
+    strcpy(packName, name);
+    packDisplaySize = hdr.displaySize;
+    Serial.printf("使用眼睛包 %s\n", packName);
+  }
+  return ok;
+}
+
+// 加载结束，之后不再从眼睛包读取
+void packEnd(void) {
+  packName[0] = 0;
+}
+
+// 在眼睛包中查找类型为 'type' 的条目（name 非 NULL 时文件名也要相同，
+// key 非零时 key 也要相同）。找到时返回 true，'file' 打开并定位到条目的
+// 数据，由调用者关闭。
+static bool packOpen(File &file, eyePackEntry *entry, uint32_t type,
+  const char *name, uint32_t key) {
+  eyePackHeader hdr;
+  if(!packName[0] || !(file = arcada.open(packName, O_READ))) return false;
+  if(file.read(&hdr, sizeof hdr) == (int)sizeof hdr) {
+    for(uint16_t i=0; i<hdr.entries; i++) {
+      if(file.read(entry, sizeof *entry) != (int)sizeof *entry) break;
+      entry->name[sizeof entry->name - 1] = 0;
+      if((entry->type == type) && (!name || !strcmp(entry->name, name)) &&
+         (!key || (entry->key == key))) {
+        if(file.seek(entry->offset)) return true;
+        break;
+      }
+    }
+  }
+  file.close();
+  return false;
+}
+
 // 配置文件处理 ---------------------------------------------
 
 // 此函数从 JSON 配置文件中解码整数值，支持多种格式...
@@ -80,12 +154,61 @@ static void getFilename(JsonVariant v, char **ptr) {
 }
 */
 
+// 应用默认值和限制，并设置一组表的几何参数（表本身在 setup() 中生成）。
+// 值为 0 表示“使用默认值”。
+static void setGeometry(eyeTables *t, int eyeRad, int irisRad, int slitRad,
+  float cover) {
+  // 默认眼睛大小设置为略大于屏幕。这是故意的，因为位移效果在其极端情况下看起来最差...
+  // 这允许瞳孔移动到显示器的边缘，同时保持与位移限制的几个像素距离。
+  if(!eyeRad) eyeRad = DISPLAY_SIZE/2 + 5;
+  else        eyeRad = abs(eyeRad);
+  if(!irisRad) irisRad = DISPLAY_SIZE/4; // 屏幕像素中的大小
+  else         irisRad = abs(irisRad);
+  slitRad = abs(slitRad);
+  if(slitRad > irisRad) slitRad = irisRad;
+  if(cover < 0.0)      cover = 0.0;
+  else if(cover > 1.0) cover = 1.0;
+  t->displaySize     = DISPLAY_SIZE;
+  t->eyeRadius       = eyeRad;
+  t->irisRadius      = irisRad;
+  t->slitPupilRadius = slitRad;
+  t->mapRadius       = (int)(eyeRad * M_PI * cover + 0.5);
+  t->mapDiameter     = t->mapRadius * 2;
+}
+
+// JSON 文档的内存从加载阶段的区域分配（见 memory.cpp）。区域中的内存在
+// arenaEnd() 时一起释放，所以 deallocate() 只释放区域放不下时的后备分配；
+// ArduinoJson 只用 reallocate() 缩小文档，块原地保留即可。
+struct arenaJsonAllocator {
+  void *allocate(size_t n) {
+    void *p = arenaAlloc(n);
+    return p ? p : heapAlloc(HEAP_LOAD, n);
+  }
+  void deallocate(void *p) {
+    if(!arenaOwns(p)) heapFree(p);
+  }
+  void *reallocate(void *p, size_t n) {
+    return p;
+  }
+};
+
 void loadConfig(char *filename) {
-  File    file;
-  uint8_t rotation = 3;
+  File         file;
+  eyePackEntry entry;
+  uint8_t      rotation = 3;
+  // 每只眼睛的几何参数（-1 = 使用全局值）
+  int     eyeRad[NUM_EYES], irisRad[NUM_EYES], slitRad[NUM_EYES];
+  float   cover[NUM_EYES];
+  uint8_t e, e2;
+
+  for(e=0; e<NUM_EYES; e++) {
+    eyeRad[e] = irisRad[e] = slitRad[e] = -1;
+    cover[e]  = -1.0;
+  }
 
-  if(file = arcada.open(filename, FILE_READ)) {
-    StaticJsonDocument<2048> doc;
+  if(packOpen(file, &entry, PACK_CONFIG, NULL, 0) ||
+     (file = arcada.open(filename, FILE_READ))) {
+    BasicJsonDocument<arenaJsonAllocator> doc(2048);
 
     yield();
     DeserializationError error = deserializeJson(doc, file);
@@ -94,8 +217,6 @@ void loadConfig(char *filename) {
       Serial.println("配置文件错误，使用默认设置");
       Serial.println(error.c_str());
     } else {
-      uint8_t e;
-
       // 适用于两只眼睛或全局程序配置的值...
       stackReserve    = dwim(doc["stackReserve"], stackReserve),
       eyeRadius       = dwim(doc["eyeRadius"]);
@@ -107,9 +228,9 @@ void loadConfig(char *filename) {
       v = doc["coverage"];
       if(v.is<int>() || v.is<float>()) coverage = v.as<float>();
       v = doc["upperEyelid"];
-      if(v.is<const char*>())    upperEyelidFilename = strdup(v);
+      if(v.is<const char*>())    upperEyelidFilename = arenaStrdup(v);
       v = doc["lowerEyelid"];
-      if(v.is<const char*>())    lowerEyelidFilename = strdup(v);
+      if(v.is<const char*>())    lowerEyelidFilename = arenaStrdup(v);
 
       lightSensorMin   = doc["lightSensorMin"] | lightSensorMin;
       lightSensorMax   = doc["lightSensorMax"] | lightSensorMax;
@@ -159,7 +280,9 @@ void loadConfig(char *filename) {
                   irisAngle    = 0,
                   scleraAngle  = 0,
                   irisiSpin    = 0,
-                  scleraiSpin  = 0;
+                  scleraiSpin  = 0,
+                  irisPriority   = eye[0].iris.priority,
+                  scleraPriority = eye[0].sclera.priority;
       float       irisSpin     = 0.0,
                   scleraSpin   = 0.0;
       JsonVariant iristv       = doc["irisTexture"],
@@ -170,6 +293,14 @@ void loadConfig(char *filename) {
 
       v = doc["tracking"];
       if(v.is<bool>()) tracking = v.as<bool>();
+      v = doc["tileTextures"];
+      if(v.is<bool>()) tileTextures = v.as<bool>();
+      v = doc["columnRing"];
+      if(v.is<int>()) columnRing = constrain(v.as<int>(), 2, MAX_COLUMNS);
+      v = doc["columnBatch"];
+      if(v.is<int>()) columnBatch = constrain(v.as<int>(), 1, MAX_BATCH);
+      v = doc["pupilRuns"];
+      if(v.is<bool>()) pupilRuns = v.as<bool>();
       v = doc["squint"];
       if(v.is<float>()) {
         trackFactor = 1.0 - v.as<float>();
@@ -190,6 +321,11 @@ void loadConfig(char *filename) {
       if(v.is<bool>() || v.is<int>()) irisMirror   = v ? 1023 : 0;
       v = doc["scleraMirror"];
       if(v.is<bool>() || v.is<int>()) scleraMirror = v ? 1023 : 0;
+      // 纹理存储器优先级，越高越先放入更快的存储器（见 memory.cpp）
+      v = doc["irisPriority"];
+      if(v.is<int>()) irisPriority   = constrain(v.as<int>(), 0, 255);
+      v = doc["scleraPriority"];
+      if(v.is<int>()) scleraPriority = constrain(v.as<int>(), 0, 255);
       for(e=0; e<NUM_EYES; e++) {
         eye[e].pupilColor    = pupilColor;
         eye[e].backColor     = backColor;
@@ -214,19 +350,29 @@ void loadConfig(char *filename) {
         eye[e].sclera.spin   = scleraSpin;
         eye[e].iris.iSpin    = irisiSpin;
         eye[e].sclera.iSpin  = scleraiSpin;
-        // iris 和 sclera 文件名是为每只眼睛 strdup 的，而不是共享一个公共指针，
-        // 原因是在覆盖其中一个时，尝试正确处理 free/strdup 会变得非常混乱。
-        // 所以这会浪费一点 RAM，但只是文件名的大小，并且只在初始化期间。NBD。
-        if(iristv.is<const char*>())   eye[e].iris.filename   = strdup(iristv);
-        if(scleratv.is<const char*>()) eye[e].sclera.filename = strdup(scleratv);
+        eye[e].iris.priority   = irisPriority;
+        eye[e].sclera.priority = scleraPriority;
+        // iris 和 sclera 文件名为每只眼睛单独复制（到区域中，arenaEnd() 时
+        // 一起释放），这样每只眼睛的覆盖只需替换指针。
+        if(iristv.is<const char*>())   eye[e].iris.filename   = arenaStrdup(iristv);
+        if(scleratv.is<const char*>()) eye[e].sclera.filename = arenaStrdup(scleratv);
         eye[e].rotation = rotation; // 可能会在每只眼睛的代码中被覆盖
       }
 
 #if NUM_EYES > 1
       // 处理任何不同的每只眼睛设置...
-      // 并非所有内容都可以每只眼睛配置。颜色和纹理内容可以。
-      // 其他内容如虹膜大小或瞳孔形状则不行，原因是没有足够的 RAM 来存储两只眼睛的极角/距离表。
-      for(uint8_t e=0; e<NUM_EYES; e++) {
+      // 几何参数（眼睛和虹膜大小、瞳孔形状、覆盖范围）也可以每只眼睛不同。
+      // 每种不同的几何需要自己的一组表（见 setup()），如果 RAM 不够，
+      // 第二只眼睛会退回使用第一只眼睛的表。
+      for(e=0; e<NUM_EYES; e++) {
+        v = doc[eye[e].name]["eyeRadius"];
+        if(!v.isNull()) eyeRad[e]  = abs(dwim(v));
+        v = doc[eye[e].name]["irisRadius"];
+        if(!v.isNull()) irisRad[e] = abs(dwim(v));
+        v = doc[eye[e].name]["slitPupilRadius"];
+        if(!v.isNull()) slitRad[e] = abs(dwim(v));
+        v = doc[eye[e].name]["coverage"];
+        if(v.is<int>() || v.is<float>()) cover[e] = v.as<float>();
         eye[e].pupilColor    = dwim(doc[eye[e].name]["pupilColor"]  , eye[e].pupilColor);
         eye[e].backColor     = dwim(doc[eye[e].name]["backColor"]   , eye[e].backColor);
         eye[e].iris.color    = dwim(doc[eye[e].name]["irisColor"]   , eye[e].iris.color);
@@ -251,15 +397,17 @@ void loadConfig(char *filename) {
         if(v.is<bool>() || v.is<int>()) eye[e].iris.mirror   = v ? 1023 : 0;
         v = doc[eye[e].name]["scleraMirror"];
         if(v.is<bool>() || v.is<int>()) eye[e].sclera.mirror = v ? 1023 : 0;
+        v = doc[eye[e].name]["irisPriority"];
+        if(v.is<int>()) eye[e].iris.priority   = constrain(v.as<int>(), 0, 255);
+        v = doc[eye[e].name]["scleraPriority"];
+        if(v.is<int>()) eye[e].sclera.priority = constrain(v.as<int>(), 0, 255);
         v = doc[eye[e].name]["irisTexture"];
-        if(v.is<const char*>()) {                           // 指定了每只眼睛的虹膜纹理？
-          if(eye[e].iris.filename) free(eye[e].iris.filename); // 删除旧名称（如果有）
-          eye[e].iris.filename = strdup(v);                    // 保存新名称
+        if(v.is<const char*>()) {                  // 指定了每只眼睛的虹膜纹理？
+          eye[e].iris.filename = arenaStrdup(v);    // 保存新名称（旧名称留在区域中）
         }
         v = doc[eye[e].name]["scleraTexture"]; // 同上，巩膜
         if(v.is<const char*>()) {
-          if(eye[e].sclera.filename) free(eye[e].sclera.filename);
-          eye[e].sclera.filename = strdup(v);
+          eye[e].sclera.filename = arenaStrdup(v);
         }
         eye[e].rotation  = doc[eye[e].name]["rotate"] | rotation;
         eye[e].rotation &= 3;
@@ -290,72 +438,168 @@ void loadConfig(char *filename) {
   // 一些默认值在 globals.h 中初始化（因为无法检查这些无效输入），
   // 其他值在此处初始化，如果有明显的标志（例如值为 0 表示“使用默认值”）。
 
-  // 默认眼睛大小设置为略大于屏幕。这是故意的，因为位移效果在其极端情况下看起来最差...
-  // 这允许瞳孔移动到显示器的边缘，同时保持与位移限制的几个像素距离。
-  if(!eyeRadius) eyeRadius = DISPLAY_SIZE/2 + 5;
-  else           eyeRadius = abs(eyeRadius);
-  eyeDiameter  = eyeRadius * 2;
   eyelidIndex &= 0xFF;      // 从表中：learn.adafruit.com/assets/61921
   eyelidColor  = eyelidIndex * 0x0101; // 将 eyelidIndex 扩展为 16 位 RGB
 
-  if(!irisRadius) irisRadius = DISPLAY_SIZE/4; // 屏幕像素中的大小
-  else            irisRadius = abs(irisRadius);
-  slitPupilRadius = abs(slitPupilRadius);
-  if(slitPupilRadius > irisRadius) slitPupilRadius = irisRadius;
-
+  // 全局几何参数（每只眼睛的值未指定时使用，眼睛运动也在此几何的地图空间中计算）
+  eyeTables g;
   if(coverage < 0.0)      coverage = 0.0;
   else if(coverage > 1.0) coverage = 1.0;
-  mapRadius   = (int)(eyeRadius * M_PI * coverage + 0.5);
-  mapDiameter = mapRadius * 2;
+  setGeometry(&g, eyeRadius, irisRadius, slitPupilRadius, coverage);
+  eyeRadius       = g.eyeRadius;
+  eyeDiameter     = eyeRadius * 2;
+  irisRadius      = g.irisRadius;
+  slitPupilRadius = g.slitPupilRadius;
+  mapRadius       = g.mapRadius;
+  mapDiameter     = g.mapDiameter;
+
+  // 表生成器和列渲染器使用的每只眼睛的几何参数。几何相同的眼睛
+  // 共享一组表。
+  for(e=0; e<NUM_EYES; e++) {
+    setGeometry(&tableSet[e],
+      (eyeRad[e]  >= 0) ? eyeRad[e]  : eyeRadius,
+      (irisRad[e] >= 0) ? irisRad[e] : irisRadius,
+      (slitRad[e] >= 0) ? slitRad[e] : slitPupilRadius,
+      (cover[e]   >= 0) ? cover[e]   : coverage);
+    eye[e].tables = &tableSet[e];
+    for(e2=0; e2<e; e2++) {
+      if((tableSet[e].eyeRadius       == tableSet[e2].eyeRadius)       &&
+         (tableSet[e].irisRadius      == tableSet[e2].irisRadius)      &&
+         (tableSet[e].slitPupilRadius == tableSet[e2].slitPupilRadius) &&
+         (tableSet[e].mapRadius       == tableSet[e2].mapRadius)) {
+        eye[e].tables = eye[e2].tables;
+        break;
+      }
+    }
+  }
 }
 
 // 眼睑和纹理贴图文件处理 ------------------------------------
 
+// Adafruit_ImageReader::loadBMP() 把整幅图像解码到堆上的画布中，
+// 图像大于剩余的 RAM 时就无法加载，之后还会留下堆碎片。下面的函数
+// 只解析文件头，然后逐行读取像素，所以只需要一个固定大小的缓冲区。
+
+#define BMP_CHUNK_PIXELS 512 // 每次读取的纹理像素数（24 位时 1536 字节）
+
+typedef struct {
+  uint32_t offset;        // 像素数据在文件中的位置
+  uint32_t rowBytes;      // 每行的字节数（填充到 4 字节的倍数）
+  int32_t  width;
+  int32_t  height;        // 总是正数；见 flip
+  uint16_t depth;         // 每像素位数
+  bool     flip;          // true = 从下到上存储（BMP 的常见情况）
+  bool     is565;         // 16 位：true = RGB565，false = RGB555
+  uint32_t paletteOffset; // 1、4、8 位：颜色表在文件中的位置...
+  uint16_t colors;        // ...和其中的颜色数
+} bmpInfo;
+
+static inline uint16_t rd16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t rd32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 读取并检查 BMP 文件头。只接受未压缩的（或 BI_BITFIELDS 的）24 位和
+// 16 位图像，以及未压缩的 1 位（眼睑）、4 位和 8 位调色板图像；
+// 其他格式返回 IMAGE_ERR_FORMAT。
+static ImageReturnCode readBMPHeader(File &file, bmpInfo *info) {
+  uint8_t hdr[58]; // 文件头 + BITMAPINFOHEADER + 第一个颜色掩码
+
+  if((file.read(hdr, sizeof hdr) != (int)sizeof hdr) ||
+     (hdr[0] != 'B') || (hdr[1] != 'M')) return IMAGE_ERR_FORMAT;
+  uint32_t compression = rd32(&hdr[30]);
+  info->offset = rd32(&hdr[10]);
+  info->width  = (int32_t)rd32(&hdr[18]);
+  info->height = (int32_t)rd32(&hdr[22]);
+  info->depth  = rd16(&hdr[28]);
+  info->flip   = true;
+  if(info->height < 0) {
+    info->height = -info->height;
+    info->flip   = false;
+  }
+  if((info->width <= 0) || !info->height || (rd16(&hdr[26]) != 1)) {
+    return IMAGE_ERR_FORMAT;
+  }
+  if((info->depth == 1) || (info->depth == 4) || (info->depth == 8)) {
+    if(compression != 0) return IMAGE_ERR_FORMAT;
+    // 颜色表在 BITMAPINFOHEADER（或更新的头）之后。biClrUsed 为 0
+    // 表示颜色表是满的。
+    uint32_t colors     = rd32(&hdr[46]);
+    info->paletteOffset = 14 + rd32(&hdr[14]);
+    info->colors        = (!colors || (colors > (1u << info->depth))) ?
+                          (1 << info->depth) : colors;
+  } else if(((info->depth != 24) && (info->depth != 16)) ||
+            ((compression != 0) && (compression != 3))) {
+    return IMAGE_ERR_FORMAT;
+  }
+  info->is565    = (info->depth == 16) && (compression == 3) &&
+                   (rd32(&hdr[54]) == 0xF800);
+  info->rowBytes = ((info->width * info->depth + 31) / 32) * 4;
+  if((info->offset + info->rowBytes * info->height) > file.size()) {
+    return IMAGE_ERR_FORMAT; // 文件被截断
+  }
+  return IMAGE_SUCCESS;
+}
+
+// 读取调色板图像的前 'n' 种颜色，转换为 RGB565（主机字节序）。
+// 文件中没有的颜色设为 0（黑色）。
+static bool readBMPPalette(File &file, const bmpInfo *info,
+  uint16_t *palette, uint16_t n) {
+  uint8_t p[4]; // B, G, R, 0
+  if(!file.seek(info->paletteOffset)) return false;
+  for(uint16_t i=0; i<n; i++) {
+    if(i < info->colors) {
+      if(file.read(p, 4) != 4) return false;
+      palette[i] = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+    } else {
+      palette[i] = 0;
+    }
+  }
+  return true;
+}
+
 // 加载一个眼睑，将位图转换为 2 个数组（每列的最小值、最大值）。
 // 传入文件名、目标数组（最小值、最大值，各 240 个元素）。
+// 位图不会整个加载到 RAM 中：文件中的每一行读入一个小缓冲区，
+// 并更新每列的最小/最大 Y 值（行的顺序无关紧要，所以从下到上存储的
+// 文件也按文件顺序读取）。
+// 眼睛包中有为同样的屏幕大小和 'init' 算好的数组时直接读取。
 ImageReturnCode loadEyelid(char *filename,
-  uint8_t *minArray, uint8_t *maxArray, uint8_t init, uint32_t maxRam) {
-  Adafruit_Image  image; // 图像对象在堆栈上，像素数据在堆上
-  int32_t         w, h;
-  uint32_t        tempBytes;
-  uint8_t        *tempPtr = NULL;
+  uint8_t *minArray, uint8_t *maxArray, uint8_t init) {
+  File            file;
+  bmpInfo         info;
+  eyePackEntry    entry;
   ImageReturnCode status;
-  Adafruit_ImageReader *reader;
+  uint8_t         buf[DISPLAY_SIZE / 8 + 2]; // 一行中落在屏幕上的字节
+  uint8_t         miny[DISPLAY_SIZE], maxy[DISPLAY_SIZE];
+  uint16_t        palette[2];
 
   yield();
-  reader = arcada.getImageReader();
-  if (!reader) {
-     return IMAGE_ERR_FILE_NOT_FOUND;
+  if(packOpen(file, &entry, PACK_EYELID, filename, 0)) {
+    bool ok = (entry.param == init) && (packDisplaySize == DISPLAY_SIZE) &&
+              (entry.bytes == 2 * DISPLAY_SIZE) &&
+              (file.read(minArray, DISPLAY_SIZE) == DISPLAY_SIZE) &&
+              (file.read(maxArray, DISPLAY_SIZE) == DISPLAY_SIZE);
+    file.close();
+    if(ok) return IMAGE_SUCCESS;
   }
 
   memset(minArray, init, DISPLAY_SIZE); // 用初始值填充眼睑数组以
   memset(maxArray, init, DISPLAY_SIZE); // 标记“此列没有眼睑数据”
 
-  // 这是 m4eyes.ino 中描述的“助推器座位”
-  yield();
-  if(reader->bmpDimensions(filename, &w, &h) == IMAGE_SUCCESS) {
-    tempBytes = ((w + 7) / 8) * h; // 位图大小（字节）
-    if (maxRam > tempBytes) {
-      if((tempPtr = (uint8_t *)malloc(maxRam - tempBytes)) != NULL) {
-        // 对 tempPtr 进行一些引用，否则优化器会删除分配！
-        tempPtr[0] = 0;
-      }
-    }
-    // 不要在此处嵌套图像读取情况。如果找到碎片问题的罪魁祸首，
-    // 这段代码（和后面的 free() 块）很容易删除。
-  }
-
-  yield();
-  if((status = reader->loadBMP(filename, image)) == IMAGE_SUCCESS) {
-    if(image.getFormat() == IMAGE_1) { // 必须是 1 位图像
-      uint16_t *palette = image.getPalette();
-      uint8_t   white = (!palette || (palette[1] > palette[0]));
-      int       x, y, ix, iy, sx1, sx2, sy1, sy2;
+  if(!(file = arcada.open(filename, O_READ))) return IMAGE_ERR_FILE_NOT_FOUND;
+  if((status = readBMPHeader(file, &info)) == IMAGE_SUCCESS) {
+    if((info.depth == 1) && readBMPPalette(file, &info, palette, 2)) { // 必须是 1 位图像
+      uint8_t white = (palette[1] > palette[0]);
+      int     x, y, ix, iy, sx1, sx2, sy1, sy2;
       // 将眼睑图像居中/裁剪到屏幕...
-      sx1 = (DISPLAY_SIZE - image.width()) / 2;  // 最左边的像素，屏幕空间
-      sy1 = (DISPLAY_SIZE - image.height()) / 2; // 最上面的像素，屏幕空间
-      sx2 = sx1 + image.width() - 1;    // 最右边的像素，屏幕空间
-      sy2 = sy1 + image.height() - 1;   // 最下面的像素，屏幕空间
+      sx1 = (DISPLAY_SIZE - info.width) / 2;  // 最左边的像素，屏幕空间
+      sy1 = (DISPLAY_SIZE - info.height) / 2; // 最上面的像素，屏幕空间
+      sx2 = sx1 + info.width - 1;       // 最右边的像素，屏幕空间
+      sy2 = sy1 + info.height - 1;      // 最下面的像素，屏幕空间
       ix  = -sx1;                       // 最左边的像素，图像空间
       iy  = -sy1;                       // 最上面的像素，图像空间
       if(sx1 <   0) sx1 =   0;          // 图像比屏幕宽
@@ -365,89 +609,565 @@ ImageReturnCode loadEyelid(char *filename,
       if(ix   <   0) ix   =   0;        // 图像比屏幕窄
       if(iy   <   0) iy   =   0;        // 图像比屏幕短
 
-      GFXcanvas1 *canvas = (GFXcanvas1 *)image.getCanvas();
-      uint8_t    *buffer = canvas->getBuffer();
-      int         bytesPerLine = (image.width() + 7) / 8;
-      for(x=sx1; x <= sx2; x++, ix++) { // 对于每列...
+      memset(miny, 255, sizeof miny); // 255 = 此列没有设置的像素
+      memset(maxy,   0, sizeof maxy);
+      int firstByte = ix / 8;                        // 每行需要的字节范围
+      int numBytes  = (ix + sx2 - sx1) / 8 - firstByte + 1;
+      int firstRow  = info.flip ? (info.height - 1 - (iy + sy2 - sy1)) : iy;
+      for(int row=firstRow; row <= firstRow + (sy2 - sy1); row++) { // 文件顺序
         yield();
-        // 获取图像缓冲区的初始指针
-        uint8_t *ptr  = &buffer[iy * bytesPerLine + ix / 8];
-        uint8_t  mask = 0x80 >> (ix & 7); // 列掩码
-        uint8_t  wbit = white ? mask : 0; // 白色像素的位值
-        int      miny = 255, maxy;
-        for(y=sy1; y<=sy2; y++, ptr += bytesPerLine) {
-          if((*ptr & mask) == wbit) { // 像素是否设置？
-            if(miny == 255) miny = y; // 如果是第一个设置的像素，设置 miny
-            maxy = y;                 // 如果有设置的像素，设置 max
+        if(!file.seek(info.offset + row * info.rowBytes + firstByte) ||
+           (file.read(buf, numBytes) != numBytes)) {
+          status = IMAGE_ERR_FORMAT;
+          break;
+        }
+        y = (info.flip ? (info.height - 1 - row) : row) - iy + sy1; // 屏幕 Y
+        int bx = ix - firstByte * 8; // buf 中的位位置
+        for(x=sx1; x <= sx2; x++, bx++) {
+          uint8_t mask = 0x80 >> (bx & 7); // 列掩码
+          uint8_t wbit = white ? mask : 0; // 白色像素的位值
+          if((buf[bx / 8] & mask) == wbit) { // 像素是否设置？
+            if(y < miny[x]) miny[x] = y;
+            if(y > maxy[x]) maxy[x] = y;
           }
         }
-        if(miny != 255) {
-          // 由于稍后使用的坐标系（屏幕旋转），
-          // 在存储之前翻转 min/max 和 Y 坐标...
-          maxArray[x] = DISPLAY_SIZE - 1 - miny;
-          minArray[x] = DISPLAY_SIZE - 1 - maxy;
+      }
+      if(status == IMAGE_SUCCESS) {
+        for(x=sx1; x <= sx2; x++) {
+          if(miny[x] != 255) {
+            // 由于稍后使用的坐标系（屏幕旋转），
+            // 在存储之前翻转 min/max 和 Y 坐标...
+            maxArray[x] = DISPLAY_SIZE - 1 - miny[x];
+            minArray[x] = DISPLAY_SIZE - 1 - maxy[x];
+          }
         }
       }
     } else {
-      status = IMAGE_ERR_FORMAT; // 不要直接返回，需要释放...
+      status = IMAGE_ERR_FORMAT;
     }
   }
+  file.close();
+
+  return status;
+}
+
+// 纹理闪存缓存：内部闪存中的每个纹理前面有一个头，记录源文件内容
+// （以及影响闪存内容的设置）的哈希，像素之后再写一次哈希作为结束标记，
+// 只有完整写入的纹理才有。同样的纹理按同样的顺序加载时，每次启动都在
+// 闪存的同一地址（见 memory.cpp），所以加载之前先检查下一个对象的位置：
+// 头和结束标记都与这次的哈希一致时，直接使用闪存中已有的纹理，不再解码
+// 和写入，也不擦除闪存。
+
+#define TEX_FLASH_MAGIC   0x58455945 // 'EYEX'，小端
+#define TEX_FLASH_VERSION 1          // 闪存中纹理的格式改变时递增
 
-  if(tempPtr) {
-    free(tempPtr);
+typedef struct {
+  uint32_t magic;
+  uint32_t key;          // textureKey()
+  uint32_t bytes;        // 像素（或索引）的字节数，之后是结束标记（key）
+  uint16_t width;
+  uint16_t height;
+  uint8_t  bpp;          // 2 = RGB565；1 = 8 位索引，512 字节调色板在头之后
+  uint8_t  tileHeight;   // texture.tileHeight
+  uint8_t  reserved[14]; // 填充到 32 字节，像素与块（缓存行）对齐
+} texFlashHeader;
+
+// 源文件内容和影响闪存内容的设置的哈希（FNV-1a）。无法打开文件时返回 0。
+// 读取整个文件比解码并写入闪存快得多。眼睛包中的纹理（'entry' 非 NULL）
+// 使用 eyepack 预先算好的内容哈希，完全不需要读取。
+static uint32_t textureKey(char *filename, const eyePackEntry *entry) {
+  File     file;
+  uint8_t  buf[512];
+  uint8_t  params[] = { TEX_FLASH_VERSION, tileTextures };
+  uint32_t h = eyePackHash(2166136261u, params, sizeof params);
+  int      n;
+  if(entry) {
+    h = eyePackHash(h, &entry->key, sizeof entry->key);
+    return h ? h : 1;
   }
-  // 图像析构函数将处理该对象数据的释放
+  if(!(file = arcada.open(filename, O_READ))) return 0;
+  while((n = file.read(buf, sizeof buf)) > 0) {
+    h = eyePackHash(h, buf, n);
+    yield();
+  }
+  file.close();
+  return h ? h : 1; // 0 表示没有哈希
+}
 
-  return status;
+// 如果闪存中下一个对象的位置保存着与 'key' 一致的完整纹理，设置 tex 的
+// 像素、尺寸和布局，保留这段闪存并返回 true。索引纹理的 data 指向闪存中
+// 的调色板（finishTextures() 复制到 RAM）。
+static bool texFlashFind(uint32_t key, texture *tex) {
+  if(availableNVM() < sizeof(texFlashHeader)) return false;
+  const texFlashHeader *hdr = (const texFlashHeader *)flashPeek();
+  if((hdr->magic != TEX_FLASH_MAGIC) || (hdr->key != key) ||
+     ((hdr->bpp != 1) && (hdr->bpp != 2))) return false;
+  uint32_t offset = sizeof(texFlashHeader) + ((hdr->bpp == 1) ? 512 : 0);
+  if((offset + hdr->bytes + sizeof(uint32_t)) > availableNVM()) return false;
+  uint8_t *pixels = (uint8_t *)hdr + offset;
+  uint32_t end;
+  memcpy(&end, &pixels[hdr->bytes], sizeof end); // 可能未对齐
+  if(end != key) return false; // 上次写入未完成
+
+  tex->width      = hdr->width;
+  tex->height     = hdr->height;
+  tex->tileHeight = hdr->tileHeight;
+  tex->index      = (hdr->bpp == 1) ? pixels : NULL;
+  if(textureBytes(tex) != hdr->bytes) {
+    tex->tileHeight = 0;
+    tex->index      = NULL;
+    return false;
+  }
+  tex->data = tex->index ? (uint16_t *)&hdr[1] : (uint16_t *)pixels;
+  tex->tier = TIER_FLASH;
+  flashSkip(offset + hdr->bytes + sizeof(uint32_t));
+  return true;
+}
+
+// 纹理写入器：加载函数把逐行的像素（或索引）交给它，它按纹理的布局
+// 写入闪存。逐行布局直接写入；块布局（tileTextures）先在加载阶段的区域
+// 中缓冲一行块（tileHeight 行），满了之后逐块写出，所以 RAM 用量只是
+// 几行，不是整幅图像。区域放不下缓冲区时退回到逐行布局。块布局的地址表
+// 在加载阶段之后由 finishTextures() 生成。
+typedef struct {
+  texture *tex;
+  uint32_t key;      // textureKey()，写在头和结束标记中
+  uint8_t  bpp;      // 每像素字节数
+  uint8_t *band;     // 一行块的缓冲区，NULL = 逐行布局
+  uint32_t stride;   // 缓冲区中一行的字节数（宽度填充到 TILE_WIDTH 的倍数）
+  uint32_t x;        // 当前行已写入的字节数
+  uint16_t row;      // 当前行在这一行块中的位置
+  uint32_t mark;     // 区域中缓冲区之前的位置
+} texWriter;
+
+// 归还写入器的缓冲区，纹理回到逐行布局
+static void texWriterAbort(texWriter *w) {
+  arenaReset(w->mark);
+  w->band            = NULL;
+  w->tex->tileHeight = 0;
+}
+
+// 开始写入纹理（tex 的宽度和高度已设置），先写入闪存缓存的头和调色板
+// （索引纹理，已是屏幕字节序）。返回像素的闪存地址，纹理放不下时
+// 返回 NULL。
+static uint8_t *texWriterBegin(texWriter *w, texture *tex, uint8_t bpp,
+  uint32_t key, const uint16_t *palette) {
+  w->tex  = tex;
+  w->key  = key;
+  w->bpp  = bpp;
+  w->band = NULL;
+  w->x    = w->row = 0;
+  w->mark = arenaMark();
+  tex->tileHeight = tileTextures ? (TILE_BYTES / (TILE_WIDTH * bpp)) : 0;
+  if(tex->tileHeight) {
+    w->stride = (tex->width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH * bpp;
+    if(!(w->band = (uint8_t *)arenaAlloc(w->stride * tex->tileHeight))) {
+      texWriterAbort(w); // 退回到逐行布局
+    }
+  }
+  uint32_t bytes = w->band ?
+    w->stride * ((tex->height + tex->tileHeight - 1) / tex->tileHeight * tex->tileHeight) :
+    (uint32_t)tex->width * tex->height * bpp;
+  uint32_t offset = sizeof(texFlashHeader) + (palette ? 512 : 0);
+  if((offset + bytes + sizeof(uint32_t)) > availableNVM()) {
+    texWriterAbort(w);
+    return NULL;
+  }
+  texFlashHeader hdr;
+  memset(&hdr, 0, sizeof hdr);
+  hdr.magic      = TEX_FLASH_MAGIC;
+  hdr.key        = key;
+  hdr.bytes      = bytes;
+  hdr.width      = tex->width;
+  hdr.height     = tex->height;
+  hdr.bpp        = bpp;
+  hdr.tileHeight = tex->tileHeight;
+  uint8_t *start = flashStreamBegin();
+  flashStreamWrite(&hdr, sizeof hdr);
+  if(palette) flashStreamWrite(palette, 512);
+  return start + offset;
 }
 
-ImageReturnCode loadTexture(char *filename, uint16_t **data,
-  uint16_t *width, uint16_t *height, uint32_t maxRam) {
-  Adafruit_Image  image; // 图像对象在堆栈上，像素数据在堆上
-  int32_t         w, h;
-  uint32_t        tempBytes;
-  uint8_t        *tempPtr = NULL;
+// 把缓冲的一行块逐块写入闪存
+static bool texWriterFlush(texWriter *w) {
+  uint8_t  tile[TILE_BYTES];
+  uint32_t n = TILE_WIDTH * w->bpp; // 块中一行的字节数
+  bool     ok = true;
+  for(uint32_t x=0; ok && (x < w->stride); x += n) {
+    for(uint16_t r=0; r<w->tex->tileHeight; r++) {
+      memcpy(&tile[r * n], &w->band[r * w->stride + x], n);
+    }
+    ok = flashStreamWrite(tile, TILE_BYTES);
+  }
+  w->row = 0;
+  return ok;
+}
+
+// 追加 'len' 字节的像素。行可以分几次写入，但一次不能跨越行尾。
+static bool texWrite(texWriter *w, const uint8_t *src, uint32_t len) {
+  if(!w->band) return flashStreamWrite(src, len);
+  uint8_t  *row   = &w->band[w->row * w->stride];
+  uint32_t  bytes = (uint32_t)w->tex->width * w->bpp;
+  memcpy(&row[w->x], src, len);
+  if((w->x += len) < bytes) return true;
+  for(; w->x < w->stride; w->x++) row[w->x] = row[w->x - w->bpp]; // 重复最后一列
+  w->x = 0;
+  return (++w->row < w->tex->tileHeight) || texWriterFlush(w);
+}
+
+// 结束写入：用最后一行填满最后一行块，归还缓冲区。成功时返回 true。
+static bool texWriterEnd(texWriter *w, bool ok) {
+  if(ok && w->band && w->row) {
+    for(uint16_t r=w->row; r<w->tex->tileHeight; r++) {
+      memcpy(&w->band[r * w->stride], &w->band[(w->row - 1) * w->stride], w->stride);
+    }
+    ok = texWriterFlush(w);
+  }
+  if(ok) ok = flashStreamWrite(&w->key, sizeof w->key); // 结束标记，纹理完整
+  ok = (flashStreamEnd() != NULL) && ok;
+  if(!ok) texWriterAbort(w);
+  arenaReset(w->mark);
+  w->band = NULL;
+  return ok;
+}
+
+// 加载 .tex 纹理（见 texfile.h），'file' 已打开并定位在 .tex 数据的开头
+// （单独的 .tex 文件或眼睛包中的条目），由调用者关闭。像素已经是屏幕
+// 字节序，所以通过一个小缓冲区直接从文件流式写入闪存，不需要任何转换。
+// 索引纹理的调色板与索引一起存入闪存（data 和 index；finishTextures()
+// 把调色板复制到 RAM）。内部闪存放不下时，如果文件在 QSPI 闪存上连续
+// 存储，调色板和像素直接从文件中读取（TIER_QSPI，总是逐行布局）。
+static ImageReturnCode loadTex(File &file, texture *tex, uint32_t key) {
+  texHeader hdr;
+  texWriter writer;
+  uint8_t   buf[512];
+  uint16_t *palette = NULL;
+  uint32_t  base = file.curPosition();
+  uint32_t  startTime = millis();
+
+  if((file.read(&hdr, sizeof hdr) != (int)sizeof hdr) || (hdr.magic != TEX_MAGIC) ||
+     ((hdr.format != TEX_FORMAT_RGB565) && (hdr.format != TEX_FORMAT_INDEXED8)) ||
+     !hdr.width || !hdr.height) {
+    return IMAGE_ERR_FORMAT;
+  }
+  if(hdr.format == TEX_FORMAT_INDEXED8) { // 调色板暂存在区域中（见 loadTexture()）
+    if(!(palette = (uint16_t *)arenaAlloc(256 * sizeof(uint16_t)))) {
+      return IMAGE_ERR_MALLOC;
+    }
+    if(file.read(palette, 256 * sizeof(uint16_t)) != (int)(256 * sizeof(uint16_t))) {
+      return IMAGE_ERR_FORMAT;
+    }
+  }
+
+  tex->width  = hdr.width;
+  tex->height = hdr.height;
+  uint8_t  bpp = palette ? 1 : 2;
+  uint8_t *dst = texWriterBegin(&writer, tex, bpp, key, palette);
+  if(!dst) { // 内部闪存放不下
+    // 直接从文件读取之前确认文件包括所有像素，否则截断的文件会使渲染器
+    // 读到闪存中其他文件的数据（写入内部闪存时由 texWriterEnd() 发现）
+    if((base + sizeof hdr + (palette ? 256 * sizeof(uint16_t) : 0) +
+        (uint32_t)hdr.width * hdr.height * bpp) > file.size()) {
+      return IMAGE_ERR_FORMAT;
+    }
+    uint32_t first, last;
+    if(file.contiguousRange(&first, &last) &&
+       (dst = qspiAddress(first, file.curPosition()))) {
+      if(palette) {
+        tex->data  = (uint16_t *)qspiAddress(first, base + sizeof hdr);
+        tex->index = dst;
+      } else {
+        tex->data  = (uint16_t *)dst;
+      }
+      tex->tier = TIER_QSPI;
+      Serial.println("纹理放不下内部闪存，从 QSPI 读取");
+      return IMAGE_SUCCESS;
+    }
+    return IMAGE_ERR_MALLOC;
+  }
+  bool ok = true;
+  for(uint16_t y=0; ok && (y < hdr.height); y++) { // 逐行，块布局需要知道行尾
+    for(uint32_t remaining = (uint32_t)hdr.width * bpp; ok && remaining; ) {
+      int n = (remaining < sizeof buf) ? remaining : sizeof buf;
+      ok = (file.read(buf, n) == n) && texWrite(&writer, buf, n);
+      remaining -= n;
+    }
+    yield();
+  }
+  if(!texWriterEnd(&writer, ok)) { // 文件被截断或闪存已满
+    return IMAGE_ERR_FORMAT;
+  }
+
+  if(palette) {
+    tex->data  = (uint16_t *)(dst - 256 * sizeof(uint16_t)); // 闪存中紧接在索引之前
+    tex->index = dst;
+  } else {
+    tex->data  = (uint16_t *)dst;
+  }
+  tex->tier = TIER_FLASH;
+  Serial.printf("纹理已加载（%d 毫秒%s）！\n", (int)(millis() - startTime),
+    tex->tileHeight ? "，块布局" : "");
+  return IMAGE_SUCCESS;
+}
+
+// 将 24 位或 16 位 BMP 纹理逐行转换为屏幕字节序的 RGB565 并流式写入
+// 闪存。4 位和 8 位调色板 BMP 变成索引纹理：调色板（data）和每像素一个
+// 字节的索引（index）写入闪存，闪存用量是 RGB565 的一半。
+// 从下到上存储的文件逐行 seek，所以闪存中总是从上到下。
+// 纹理大小只受剩余闪存的限制，不受 RAM 的限制。
+static ImageReturnCode loadBMPStream(char *filename, texture *tex, uint32_t key) {
+  File            file;
+  bmpInfo         info;
+  texWriter       writer;
   ImageReturnCode status;
-  Adafruit_ImageReader *reader;
+  uint8_t         buf[BMP_CHUNK_PIXELS * 3];
+  uint16_t       *palette = NULL;
+  uint32_t        startTime = millis();
 
-  yield();
-  reader = arcada.getImageReader();
-  if (!reader) {
-     return IMAGE_ERR_FILE_NOT_FOUND;
-  }
-  
-  // 这是 m4eyes.ino 中描述的“助推器座位”
-  if(reader->bmpDimensions(filename, &w, &h) == IMAGE_SUCCESS) {
-    tempBytes = w * h * 2; // 图像大小（字节）（转换为 16bpp）
-    if (maxRam > tempBytes) {
-      if((tempPtr = (uint8_t *)malloc(maxRam - tempBytes)) != NULL) {
-        // 对 tempPtr 进行一些引用，否则优化器会删除分配！
-        tempPtr[0] = 0;
+  if(!(file = arcada.open(filename, O_READ))) return IMAGE_ERR_FILE_NOT_FOUND;
+  if((status = readBMPHeader(file, &info)) != IMAGE_SUCCESS) {
+    file.close();
+    return status;
+  }
+  if(info.depth == 1) { // 眼睑格式，不是纹理
+    file.close();
+    return IMAGE_ERR_FORMAT;
+  }
+  bool indexed = (info.depth <= 8);
+  if((info.width > 65535) || (info.height > 65535)) {
+    file.close();
+    return IMAGE_ERR_MALLOC;
+  }
+  if(indexed) { // 调色板暂存在区域中（见 loadTexture()）
+    if(!(palette = (uint16_t *)arenaAlloc(256 * sizeof(uint16_t)))) {
+      file.close();
+      return IMAGE_ERR_MALLOC;
+    }
+    if(!readBMPPalette(file, &info, palette, 256)) {
+      file.close();
+      return IMAGE_ERR_FORMAT;
+    }
+    for(uint16_t i=0; i<256; i++) { // 大端，与屏幕相同
+      palette[i] = __builtin_bswap16(palette[i]);
+    }
+  }
+
+  tex->width  = info.width;
+  tex->height = info.height;
+  uint8_t *dst = texWriterBegin(&writer, tex, indexed ? 1 : 2, key, palette);
+  if(!dst) { // 内部闪存放不下（BMP 需要转换，不能从 QSPI 读取；可改用 .tex）
+    file.close();
+    return IMAGE_ERR_MALLOC;
+  }
+  bool ok = true;
+  for(int32_t y=0; ok && (y < info.height); y++) {
+    ok = file.seek(info.offset +
+      (info.flip ? (info.height - 1 - y) : y) * info.rowBytes);
+    for(int32_t x=0; ok && (x < info.width); ) {
+      int32_t n = info.width - x;
+      if(n > BMP_CHUNK_PIXELS) n = BMP_CHUNK_PIXELS; // 偶数，4 位时不会拆开字节
+      int bytes = (n * info.depth + 7) / 8;
+      if(!(ok = (file.read(buf, bytes) == bytes))) break;
+      if(info.depth == 4) {
+        // 就地展开为每像素一个字节，从后向前，以免覆盖尚未读取的字节
+        for(int32_t i=n-1; i>=0; i--) {
+          buf[i] = (i & 1) ? (buf[i / 2] & 0x0F) : (buf[i / 2] >> 4);
+        }
+      } else if(!indexed) {
+        // 就地转换：输出（每像素 2 字节）从不超过输入的位置
+        for(int32_t i=0; i<n; i++) {
+          uint16_t c;
+          if(info.depth == 24) {
+            uint8_t *p = &buf[i * 3]; // B, G, R
+            c = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+          } else if(info.is565) {
+            c = rd16(&buf[i * 2]);
+          } else { // 555
+            uint16_t p = rd16(&buf[i * 2]);
+            c = ((p & 0x7FE0) << 1) | ((p & 0x0200) >> 4) | (p & 0x001F);
+          }
+          buf[i * 2]     = c >> 8; // 大端，与屏幕相同
+          buf[i * 2 + 1] = c;
+        }
       }
+      ok = texWrite(&writer, buf, n * (indexed ? 1 : 2));
+      x += n;
     }
-    // 不要在此处嵌套图像读取情况。如果找到碎片问题的罪魁祸首，
-    // 这段代码（和后面的 free() 块）很容易删除。
+    yield();
+  }
+  file.close();
+  // 文件头已经检查过，所以这里的失败不是格式问题（不应退回到 loadBMP()）
+  if(!texWriterEnd(&writer, ok)) { // 闪存已满或读取失败
+    return IMAGE_ERR_MALLOC;
   }
 
+  if(indexed) {
+    tex->data  = (uint16_t *)(dst - 256 * sizeof(uint16_t)); // 闪存中紧接在索引之前
+    tex->index = dst;
+  } else {
+    tex->data  = (uint16_t *)dst;
+  }
+  tex->tier = TIER_FLASH;
+  Serial.printf("纹理已加载（%d 毫秒%s%s）！\n", (int)(millis() - startTime),
+    indexed ? "，8 位索引" : "", tex->tileHeight ? "，块布局" : "");
+  return IMAGE_SUCCESS;
+}
+
+// 用 Adafruit_ImageReader 加载 loadBMPStream() 不支持的 BMP 格式
+static ImageReturnCode loadBMPReader(char *filename, texture *tex) {
+  Adafruit_Image        image; // 图像对象在堆栈上，像素数据在堆上
+  ImageReturnCode       status;
+  Adafruit_ImageReader *reader;
+
   yield();
+  if(!(reader = arcada.getImageReader())) return IMAGE_ERR_FILE_NOT_FOUND;
   if((status = reader->loadBMP(filename, image)) == IMAGE_SUCCESS) {
     if(image.getFormat() == IMAGE_16) { // 必须是 16 位图像
       Serial.println("纹理已加载！");
       GFXcanvas16 *canvas = (GFXcanvas16 *)image.getCanvas();
       canvas->byteSwap(); // 匹配屏幕的字节序以进行直接 DMA 传输
-      *width  = image.width();
-      *height = image.height();
-      *data = (uint16_t *)arcada.writeDataToFlash((uint8_t *)canvas->getBuffer(),
-        (int)*width * (int)*height * 2);
+      tex->width  = image.width();
+      tex->height = image.height();
+      tex->data   = (uint16_t *)writeDataToFlash((uint8_t *)canvas->getBuffer(),
+        (int)tex->width * (int)tex->height * 2);
+      tex->tier   = TIER_FLASH;
     } else {
-      status = IMAGE_ERR_FORMAT; // 不要直接返回，需要释放...
+      status = IMAGE_ERR_FORMAT;
     }
   }
-
-  if(tempPtr) {
-    free(tempPtr);
-  }
   // 图像析构函数将处理该对象数据的释放
+  return status;
+}
+
+// 加载纹理，设置 tex 的 data、index、width、height 和块布局字段。
+// index 对 16 位纹理为 NULL；对 8 位索引纹理（4 位或 8 位调色板 BMP，
+// 或索引 .tex 文件）指向闪存中的索引，data 指向闪存中的 256 色调色板
+// （finishTextures() 把它复制到 RAM，并生成块布局的地址表）。
+// 失败时 tex 的块布局字段为 0/NULL，调用者把纹理改为纯色。
+// 加载时的临时内存都来自加载阶段的区域，返回前归还。
+// 眼睛包中有这个文件名的纹理时从包中读取（总是 .tex 格式）。
+ImageReturnCode loadTexture(char *filename, texture *tex) {
+  ImageReturnCode status;
+  File            file;
+  eyePackEntry    entry;
+  uint32_t        mark = arenaMark();
+  bool            packed = packOpen(file, &entry, PACK_TEXTURE, filename, 0);
 
+  tex->index      = NULL;
+  tex->tileHeight = 0;
+  tex->rowOffset  = NULL;
+  tex->colOffset  = NULL;
+  // 与上次启动相同的纹理已经在闪存中？
+  uint32_t key = textureKey(filename, packed ? &entry : NULL);
+  if(key) {
+    if(texFlashFind(key, tex)) {
+      if(packed) file.close();
+      textureCacheHits++;
+      Serial.println("纹理已在闪存中（与上次启动相同）！");
+      return IMAGE_SUCCESS;
+    }
+    textureCacheMisses++;
+  }
+  int len = strlen(filename);
+  if(packed) {
+    status = loadTex(file, tex, key);
+    file.close();
+  } else if((len > 4) && !strcasecmp(&filename[len - 4], ".tex")) {
+    if(!(file = arcada.open(filename, O_READ))) {
+      status = IMAGE_ERR_FILE_NOT_FOUND;
+    } else {
+      status = loadTex(file, tex, key);
+      file.close();
+    }
+  } else {
+    // 24、16、8 和 4 位 BMP 也流式读取。其他格式（如果有）仍然交给
+    // Adafruit_ImageReader，它在堆上分配整幅图像大小的 RAM（不经过区域），
+    // 并且总是逐行存储。
+    status = loadBMPStream(filename, tex, key);
+    if(status == IMAGE_ERR_FORMAT) status = loadBMPReader(filename, tex);
+  }
+  arenaReset(mark);
   return status;
-}
\ No newline at end of file
+}
+
+// 表缓存 ----------------------------------------------------------------
+
+// calcMap() 和 calcDisplacement() 每次启动都为每个像素运行 sqrt() 和 atan2()，
+// 但它们的输入（屏幕大小和眼睛几何）很少改变。生成的表保存在
+// 文件系统的 TABLE_CACHE_DIR 中，文件名是几何参数的哈希值；之后的启动
+// 直接把文件读入表的位置。任何几何参数（或 TABLE_FORMAT）改变时哈希
+// 也改变，找不到匹配的文件，就重新生成表。可以从电脑上删除整个
+// TABLE_CACHE_DIR 目录来强制重新生成。
+
+// 文件格式（tableCacheHeader）和 tableKey() 在 eyepack.h 中，眼睛包中的
+// 表使用同样的格式。
+
+#define TABLE_CACHE_DIR "/.eyecache"
+
+static void tableCachePath(uint32_t key, char *path) {
+  sprintf(path, TABLE_CACHE_DIR "/%08lX.tab", (unsigned long)key);
+}
+
+// 尝试从眼睛包或缓存加载一组表。成功时分配并填充 t->polar 和
+// t->displace 并返回 true；否则不分配任何内容，返回 false（调用者应
+// 生成表）。
+bool loadTables(eyeTables *t) {
+  tableCacheHeader hdr;
+  eyePackEntry     entry;
+  uint32_t         key = tableKey(t);
+  char             path[32];
+  File             file;
+  bool             ok = false;
+
+  if(!packOpen(file, &entry, PACK_TABLES, NULL, key)) {
+    tableCachePath(key, path);
+    if(!(file = arcada.open(path, O_READ))) return false;
+  }
+  yield();
+  if((file.read(&hdr, sizeof hdr) == (int)sizeof hdr) &&
+     (hdr.magic == TABLE_CACHE_MAGIC) && (hdr.key == key) &&
+     (hdr.polarBytes    == (uint32_t)polarMapSize(t, hdr.octant)) &&
+     (hdr.displaceBytes == (uint32_t)((t->displaySize / 2) * (t->displaySize / 2)))) {
+    polarEntry *polar    = (polarEntry *)heapAlloc(HEAP_TABLES, hdr.polarBytes);
+    uint8_t    *displace = (uint8_t *)heapAlloc(HEAP_TABLES, hdr.displaceBytes);
+    if(polar && displace &&
+       (file.read(polar   , hdr.polarBytes)    == (int)hdr.polarBytes) &&
+       (file.read(displace, hdr.displaceBytes) == (int)hdr.displaceBytes)) {
+      t->polar    = polar;
+      t->displace = displace;
+      t->octant   = hdr.octant;
+      ok          = true;
+    } else {
+      heapFree(polar);
+      heapFree(displace);
+    }
+  }
+  file.close();
+  return ok;
+}
+
+// 将新生成的表写入缓存。失败（例如文件系统已满）不是致命的，
+// 下次启动只是重新生成表。
+void saveTables(const eyeTables *t) {
+  tableCacheHeader hdr;
+  char             path[32];
+  File             file;
+
+  if(!t->polar || !t->displace) return;
+  memset(&hdr, 0, sizeof hdr);
+  hdr.magic         = TABLE_CACHE_MAGIC;
+  hdr.key           = tableKey(t);
+  hdr.polarBytes    = polarMapSize(t, t->octant);
+  hdr.displaceBytes = (t->displaySize / 2) * (t->displaySize / 2);
+  hdr.octant        = t->octant;
+
+  if(!arcada.exists(TABLE_CACHE_DIR)) arcada.mkdir(TABLE_CACHE_DIR);
+  tableCachePath(hdr.key, path);
+  if(!(file = arcada.open(path, O_WRITE | O_CREAT | O_TRUNC))) return;
+  yield();
+  bool ok = (file.write((uint8_t *)&hdr        , sizeof hdr)        == sizeof hdr) &&
+            (file.write((uint8_t *)t->polar    , hdr.polarBytes)    == hdr.polarBytes) &&
+            (file.write((uint8_t *)t->displace , hdr.displaceBytes) == hdr.displaceBytes);
+  file.close();
+  if(!ok) arcada.remove(path); // 不要留下不完整的文件
+}
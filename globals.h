@@ -6,6 +6,10 @@
 
 //#include "Adafruit_Arcada.h"
 #include "DMAbuddy.h" // DMA 问题修复类
+#include "render.h"   // 列渲染器和表生成器（可在主机上编译）
+#include "heapstat.h" // 按子系统统计的堆分配（可在主机上编译）
+#include "texfile.h"  // .tex 纹理文件格式
+#include "eyepack.h"  // .eyp 眼睛包格式
 
 #if defined(GLOBAL_VAR) // 仅在 .ino 文件中定义
   #define GLOBAL_INIT(X) = (X)
@@ -15,6 +19,10 @@
   #define GLOBAL_INIT(X)
 #endif
 
+// 取消注释以使用 tools/bakeeye 生成的 fixedtables.h 中编译进闪存的表，
+// 而不是在启动时生成表（放在堆 RAM 中）。用于永久使用一个预设的设备。
+//#define FIXED_TABLES
+
 #if defined(ARCADA_LEFTTFT_SPI) // MONSTER M4SK 或自定义 Arcada 设置
   #define NUM_EYES 2
   // MONSTER M4SK 光线传感器默认不启用。
@@ -31,7 +39,13 @@ GLOBAL_VAR bool      showSplashScreen    GLOBAL_INIT(true);   // 设置为 false
 
 #define MAX_DISPLAY_SIZE 240
 GLOBAL_VAR int       DISPLAY_SIZE        GLOBAL_INIT(240);    // 假设显示为 240x240
-GLOBAL_VAR uint32_t  stackReserve        GLOBAL_INIT(5192);   // 参见图像加载代码
+GLOBAL_VAR uint32_t  stackReserve        GLOBAL_INIT(5192);   // 表和 SRAM 纹理分配之后至少保留的 RAM
+GLOBAL_VAR bool      tileTextures        GLOBAL_INIT(false);  // true = 纹理按块布局存入闪存（见 render.h）
+GLOBAL_VAR uint8_t   columnRing          GLOBAL_INIT(4);      // 每只眼睛的列结构数（2 到 MAX_COLUMNS，RAM 允许时）
+GLOBAL_VAR uint8_t   columnBatch         GLOBAL_INIT(8);      // 分配的列结构每个最多容纳的列数（1 到 MAX_BATCH，RAM 允许时）
+GLOBAL_VAR bool      pupilRuns           GLOBAL_INIT(false);  // true = HalloWing 上瞳孔也作为纯色段发出（查找有开销，尚未在开发板上测量）
+GLOBAL_VAR uint16_t  textureCacheHits    GLOBAL_INIT(0);      // 闪存中已有的纹理（见 file.cpp）
+GLOBAL_VAR uint16_t  textureCacheMisses  GLOBAL_INIT(0);      // 需要重新写入闪存的纹理
 GLOBAL_VAR int       eyeRadius           GLOBAL_INIT(0);      // 0 = 在 loadConfig() 中使用默认值
 GLOBAL_VAR int       eyeDiameter;                             // 稍后根据 eyeRadius 计算
 GLOBAL_VAR int       irisRadius          GLOBAL_INIT(60);     // 屏幕像素中的近似大小
@@ -49,13 +63,13 @@ GLOBAL_VAR uint16_t  eyelidColor         GLOBAL_INIT(0x0000); // 将 eyelidIndex
 // 偶尔会看到眼睛背面的新月形颜色（巩膜纹理地图可以设计为与之混合）。
 // eyeRadius 在 loadConfig() 中计算为 eyeRadius * Pi * coverage ——
 // 如果 eyeRadius 为 125，coverage 为 0.6，mapRadius 将为 236 像素，
-// 生成的极角/距离地图将总共占用约 111K RAM。
+// 圆形瞳孔的极角/距离地图只存储一个八分圆，约 55K RAM（狭缝瞳孔
+// 需要整个象限，约 111K）。地图大小与 mapRadius 的平方成正比，所以
+// 圆形瞳孔的眼睛可以把 coverage 提高到约 0.85 而不使用更多 RAM。
 GLOBAL_VAR float     coverage            GLOBAL_INIT(0.6);
 GLOBAL_VAR int       mapRadius;          // 在 loadConfig() 中计算
 GLOBAL_VAR int       mapDiameter;        // 在 loadConfig() 中计算
-GLOBAL_VAR uint8_t  *displace            GLOBAL_INIT(NULL);
-GLOBAL_VAR uint8_t  *polarAngle          GLOBAL_INIT(NULL);
-GLOBAL_VAR int8_t   *polarDist           GLOBAL_INIT(NULL);
+GLOBAL_VAR eyeTables tableSet[NUM_EYES]; // 每只眼睛的几何和表（几何相同时共享），见 loadConfig()
 GLOBAL_VAR uint8_t   upperOpen[MAX_DISPLAY_SIZE];
 GLOBAL_VAR uint8_t   upperClosed[MAX_DISPLAY_SIZE];
 GLOBAL_VAR uint8_t   lowerOpen[MAX_DISPLAY_SIZE];
@@ -86,7 +100,7 @@ GLOBAL_VAR int8_t    blinkPin            GLOBAL_INIT(-1); // 手动双眼眨眼
 #else
   GLOBAL_VAR int8_t  boopPin             GLOBAL_INIT(-1);
 #endif
-GLOBAL_VAR uint32_t  boopThreshold       GLOBAL_INIT(17500);
+GLOBAL_VAR uint32_t  boopThreshold       GLOBAL_INIT(1167); // BOOP_READS 次读取的总和，setup() 中重新校准
 
 #if defined(ADAFRUIT_MONSTER_M4SK_EXPRESS)
 GLOBAL_VAR bool      voiceOn             GLOBAL_INIT(false);
@@ -99,25 +113,46 @@ GLOBAL_VAR uint32_t  modulate            GLOBAL_INIT(30); // Dalek 音高
 
 // 眼睛相关结构 --------------------------------------------------
 
-// 眼睛是按列渲染的，使用 DMA 在计算下一列时发出一列数据，
-// 在两个列结构之间交替（无论如何，缓冲整个 240x240 屏幕的 RAM 几乎不够）。
-// 每个正在渲染/发出的列使用 1 到 3 个链接的 DMA 描述符，
+// 眼睛是按列渲染的，使用 DMA 在计算下一列时发出数据，
+// 列结构组成每只眼睛的一个环形缓冲区（无论如何，缓冲整个 240x240 屏幕的
+// RAM 几乎不够）：渲染可以领先 DMA 几列，吸收 user_loop()、光线传感器
+// 和触摸传感器造成的停顿。一个列结构容纳 1 到 'columns' 个相邻的列，
+// 像素连续存放，作为一个 DMA 作业发出（一次 startJob() 和一次完成的
+// 中断，而不是每列一次）。前两个列结构是静态的，每个一列；其余的（最多
+// columnRing 个）在 setup() 结束时用剩余的 RAM 分配，每个 K 列，K 是
+// RAM 允许的最大值（不超过 columnBatch）。
+// 每个列使用 1 到 NUM_DESCRIPTORS 个链接的 DMA 描述符，
 // 通常包含：1) 眼睑区域“下方”的背景像素，
 // 2) 眼睛内部的渲染像素（绘制在 renderBuf[] 扫描线缓冲区中，
-// 分配为 240 像素以匹配屏幕大小，尽管通常只使用一部分），
-// 和 3) 眼睑区域“上方”的更多背景像素。
+// 每列 DISPLAY_SIZE 像素以匹配屏幕大小，尽管通常只使用一部分），
+// 和 3) 眼睑区域“上方”的更多背景像素。眼睛内部长的纯色段（瞳孔、
+// 眼睛背面，见 render.h 中的 colorRuns）也不渲染，每段一个描述符，中间
+// 渲染的像素再各用一个。一个列结构中各列的描述符依次链接成一个列表。
+// 每帧不一定发出整个屏幕：loop() 在帧开始时算出眼睑之间睁开部分的外接
+// 矩形，与上一帧的合并（上一帧睁开、现在被眼睑盖住的部分需要画一次
+// 眼睑颜色），只渲染和发出这个窗口中的列和像素。眼睑部分闭合时，
+// SPI 传输的字节少得多；眼睑不动时，窗口外的眼睑颜色不再重复发出。
 #if NUM_EYES > 1
   #define NUM_DESCRIPTORS 1 // 参见下面的注释
 #else
-  #define NUM_DESCRIPTORS 3
+  #define NUM_DESCRIPTORS (3 + 2 * MAX_RUNS) // 眼睑、纯色段和它们之间的渲染像素
 #endif
   // 重要提示：原始计划（如上所述，使用动态描述符列表）被硅片错误（记录在 SAMD51 勘误表中）
   // 破坏了，当在多个通道上使用链接描述符时。目前的解决方法是跳过眼睑优化，
-  // 完全缓冲/渲染每一行，使用单个描述符。这对于单眼不是问题（因为只有一个通道），
-  // 我们仍然可以在 HalloWing M4 上使用此技巧。
+  // 完全缓冲/渲染每一行，使用单个描述符（发出列结构中所有连续的列）。
+  // 这对于单眼不是问题（因为只有一个通道），我们仍然可以在 HalloWing M4 上使用此技巧。
+#define MAX_COLUMNS 8 // 每只眼睛的列结构数的上限
+#define MAX_BATCH   8 // 一个列结构的列数的上限
 typedef struct {
-  uint16_t       renderBuf[MAX_DISPLAY_SIZE]; // 像素缓冲区
-  DmacDescriptor descriptor[NUM_DESCRIPTORS]; // DMA 描述符列表
+  DmacDescriptor *descriptor; // DMA 描述符列表，每列 NUM_DESCRIPTORS 个
+  uint16_t       *renderBuf;  // 像素缓冲区，每列 DISPLAY_SIZE 像素，连续存放
+  uint8_t         columns;    // 容量（列数）
+  uint8_t         x;          // 第一列的屏幕列号（0-239）
+  bool            first;      // true = 帧的第一个列结构，发出之前设置地址窗口：
+  uint8_t         winX, winY; // 窗口的第一列和列中的第一个像素，
+  uint8_t         winW, winH; // 列数和每列的像素数（renderBuf 中每列的间距）
+  uint16_t        pixels;     // 此次发出的像素数（列数 x winH），DMA 超时按它计算
+  volatile bool   ready;      // true = 已渲染，等待或正在发出
 } columnStruct;
 
 // 使用简单的状态机来控制眼睛的眨眼/眨眼：
@@ -130,23 +165,15 @@ typedef struct {
   uint32_t startTime;   // 上次状态更改的时间（微秒）
 } eyeBlink;
 
-// 虹膜和巩膜纹理地图的数据
-typedef struct {
-  char     *filename;
-  float     spin;       // RPM * 1024.0
-  uint16_t  color;
-  uint16_t *data;
-  uint16_t  width;
-  uint16_t  height;
-  uint16_t  startAngle; // 初始旋转 0-1023 逆时针
-  uint16_t  angle;      // 当前旋转 0-1023 逆时针
-  uint16_t  mirror;     // 0 = 正常，1023 = 翻转 X 轴
-  uint16_t  iSpin;      // 每帧固定整数旋转，覆盖 'spin' 值
-} texture;
+// 纹理像素所在的存储器（texture.tier），从快到慢。见 memory.cpp 中的 placeTextures()。
+#define TIER_NONE  0    // 纯色纹理，没有像素
+#define TIER_SRAM  1    // 表生成之后从闪存复制到剩余的 RAM 中
+#define TIER_FLASH 2    // 内部闪存（加载时写入）
+#define TIER_QSPI  3    // QSPI 闪存上的 .tex 文件，内存映射读取（内部闪存放不下时）
 
 // 每只眼睛使用以下结构。每只眼睛必须位于其自己的 SPI 总线上，
 // 具有独立的控制线（与 Uncanny Eyes 代码不同，后者它们轮流使用一个总线）。
-// 两个如上所述的列结构，然后是大量 DMA 细节和动画状态数据。
+// 如上所述的列环形缓冲区，然后是大量 DMA 细节和动画状态数据。
 typedef struct {
   // 这些值在下面的表中初始化：
   const char      *name;         // 用于加载每只眼睛的配置
@@ -156,19 +183,33 @@ typedef struct {
   int8_t           rst;          // RST 引脚 #（-1 如果使用 Seesaw）
   int8_t           winkPin;      // 手动眼睛眨眼控制（-1 = 无）
   // 其余值在代码中初始化：
-  columnStruct     column[2];    // 交替列结构 A/B
+  uint16_t         pixelBuf[2][MAX_DISPLAY_SIZE]; // 静态的两个列结构的像素...
+  DmacDescriptor   descriptorBuf[2][NUM_DESCRIPTORS] // ...和描述符（DMAC 要求
+                     __attribute__((aligned(16)));    // 128 位对齐）
+  columnStruct     column[MAX_COLUMNS]; // 列环形缓冲区
+  uint8_t          numColumns;   // 环中的列结构数
+  uint8_t          colHead;      // 下一个渲染的 column[] 索引（生产者）
+  volatile uint8_t colTail;      // 下一个发出的 column[] 索引（消费者，DMA 完成时前进）
   Adafruit_SPITFT *display;      // 指向显示对象的指针
   DMAbuddy         dma;          // 带有 fix() 函数的 DMA 通道对象
   DmacDescriptor  *dptr;         // DMA 通道描述符指针
   uint32_t         dmaStartTime; // 用于 DMA 超时处理程序
-  uint8_t          colNum;       // 列计数器（0-239）
-  uint8_t          colIdx;       // 交替 0/1 索引到 column[] 数组
-  bool             dma_busy;     // true = DMA 传输正在进行
-  bool             column_ready; // true = 下一列已渲染
+  uint16_t         dmaPixels;    // 正在进行的传输的像素数，超时按它计算
+  uint8_t          colNum;       // 下一个渲染的列（0-239），0 = 开始新的一帧
+  uint8_t          winX, winY;   // 正在渲染的帧的窗口（见 columnStruct）
+  uint8_t          winW, winH;
+  int16_t          openX0, openX1; // 上一帧睁开部分的外接矩形（列和像素，包括两端，
+  int16_t          openY0, openY1; // openX0 > openX1 = 没有），开始时和 DMA 卡住后为整个屏幕
+  volatile bool    dma_busy;     // true = DMA 传输正在进行
+  volatile uint32_t idleStart;   // 上次 DMA 完成的时间（微秒）
+  volatile uint32_t idleTime;    // SPI 总线空闲的累计时间（微秒），每秒报告并清零
   uint16_t         pupilColor;   // 16 位 565 RGB，大端格式
   uint16_t         backColor;    // 16 位 565 RGB，大端格式
   texture          iris;         // 虹膜纹理地图
   texture          sclera;       // 巩膜纹理地图
+  columnRenderer   renderer;     // 为此眼睛的纹理组合专门化的列渲染器
+  eyeTables       *tables;       // 此眼睛的几何和表（可能与另一只眼睛共享）
+  float            mapScale;     // 全局地图空间中的眼睛运动到此眼睛地图的缩放
   uint8_t          rotation;     // 屏幕旋转（GFX 库）
 
   // 从 Uncanny Eyes 代码继承的内容。现在需要独立于每只眼睛，
@@ -177,6 +218,7 @@ typedef struct {
   eyeBlink blink;
   float    eyeX, eyeY;  // 保存每只眼睛以避免撕裂
   float    pupilFactor; // 同上
+  int      iPupilFactor; // 由 pupilFactor 每帧计算一次的虹膜纹理 Y 缩放
   float    blinkFactor;
   float    upperLidFactor, lowerLidFactor;
 } eyeStruct;
@@ -202,14 +244,36 @@ extern void            handle_filesystem_change();
 // 当文件系统内容更改时设置为 true。
 // 最初设置为 true，以便程序以“更改”任务开始。
 extern bool            filesystem_change_flag GLOBAL_INIT(true);
+extern bool            presetExists(char *configName);
+extern bool            packBegin(char *configName);
+extern void            packEnd(void);
 extern void            loadConfig(char *filename);
-extern ImageReturnCode loadEyelid(char *filename, uint8_t *minArray, uint8_t *maxArray, uint8_t init, uint32_t maxRam);
-extern ImageReturnCode loadTexture(char *filename, uint16_t **data, uint16_t *width, uint16_t *height, uint32_t maxRam);
+extern ImageReturnCode loadEyelid(char *filename, uint8_t *minArray, uint8_t *maxArray, uint8_t init);
+extern ImageReturnCode loadTexture(char *filename, texture *tex);
+extern bool            loadTables(eyeTables *t);
+extern void            saveTables(const eyeTables *t);
 
 // memory.cpp 中的函数
 extern uint32_t        availableRAM(void);
 extern uint32_t        availableNVM(void);
 extern uint8_t        *writeDataToFlash(uint8_t *src, uint32_t len);
+extern uint8_t        *flashStreamBegin(void);
+extern bool            flashStreamWrite(const void *src, uint32_t len);
+extern uint8_t        *flashStreamEnd(void);
+extern const uint8_t  *flashPeek(void);
+extern void            flashSkip(uint32_t len);
+extern bool            arenaBegin(void);
+extern void           *arenaAlloc(uint32_t bytes);
+extern char           *arenaStrdup(const char *str);
+extern bool            arenaOwns(const void *p);
+extern uint32_t        arenaMark(void);
+extern void            arenaReset(uint32_t mark);
+extern void            arenaEnd(void);
+extern int             texturesByPriority(texture **list);
+extern void            finishTextures(void);
+extern void            placeTextures(void);
+extern uint8_t        *qspiAddress(uint32_t sector, uint32_t offset);
+extern void            qspiMapTextures(void);
 
 // pdmvoice.cpp 中的函数
 #if defined(ADAFRUIT_MONSTER_M4SK_EXPRESS)
@@ -220,11 +284,7 @@ extern void              voiceMod(uint32_t freq, uint8_t waveform);
 extern volatile uint16_t voiceLastReading;
 #endif // ADAFRUIT_MONSTER_M4SK_EXPRESS
 
-// tablegen.cpp 中的函数
-extern void            calcDisplacement(void);
-extern void            calcMap(void);
-extern float           screen2map(int in);
-extern float           map2screen(int in);
+// render.cpp 和 tablegen.cpp 中的函数在 render.h 中声明
 
 // user.cpp 中的函数
 extern void            user_setup(void);
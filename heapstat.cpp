@@ -0,0 +1,233 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 堆的使用情况统计（见 heapstat.h）。
+
+#include "heapstat.h"
+
+#if defined(ARDUINO)
+  #include <Arduino.h>
+  #include <unistd.h> // sbrk()
+  #define heapPrintf Serial.printf
+#else
+  #include <stdio.h>
+  #include <stdlib.h>
+  #include <string.h>
+  #define heapPrintf printf
+#endif
+
+// 每个 heapAlloc() 块之前的块头，记录子系统和请求的大小，heapFree()
+// 据此更新统计。8 字节，返回的指针仍然 8 字节对齐。
+typedef struct {
+  uint32_t bytes;
+  uint8_t  tag;
+  uint8_t  reserved[3];
+} heapHeader;
+
+static uint32_t live[HEAP_TAGS], peak[HEAP_TAGS], topPeak;
+static uint16_t blocks[HEAP_TAGS];
+
+static const char *tagName[HEAP_TAGS] = {
+  "其他", "表", "纹理", "语音", "用户", "加载", "列" };
+
+#if defined(ARDUINO)
+
+// newlib-nano（nano.specs）malloc 的内部状态，见 newlib 的 nano-mallocr.c：
+// 空闲块按地址排序链接，size 包括块头；堆从 __malloc_sbrk_start 开始，
+// 到 sbrk(0) 为止。
+extern "C" {
+  typedef struct nanoChunk {
+    long              size;
+    struct nanoChunk *next;
+  } nanoChunk;
+  extern nanoChunk *__malloc_free_list;
+  extern char      *__malloc_sbrk_start;
+}
+
+static inline void *rawAlloc(size_t bytes) { return malloc(bytes); }
+static inline void  rawFree(void *ptr)     { free(ptr); }
+
+// 堆顶（从堆的开始算起）
+static uint32_t heapTop(void) {
+  return __malloc_sbrk_start ? ((char *)sbrk(0) - __malloc_sbrk_start) : 0;
+}
+
+static void heapWalk(heapStats *s) {
+  char     top;                          // 局部变量在堆栈上
+  uint32_t listBytes = 0;
+  for(nanoChunk *c = __malloc_free_list; c; c = c->next) {
+    s->freeBlocks++;
+    listBytes += c->size;
+    if((uint32_t)c->size > s->largestFree) s->largestFree = c->size;
+  }
+  uint32_t gap = &top - (char *)sbrk(0); // 与 availableRAM() 相同
+  s->used        = heapTop() - listBytes;
+  s->freeBytes   = listBytes + gap;
+  if(gap > s->largestFree) s->largestFree = gap;
+}
+
+#else // 主机
+
+// 模拟的堆：一块固定大小的内存，按 newlib-nano malloc 的规则分配（块头
+// 之后是数据，空闲块按地址排序，首次适配，从空闲块的末尾切出分配的块，
+// 释放时与相邻的空闲块合并，堆顶从不收缩），所以同样的分配序列在主机
+// 上产生与开发板上大致相同的空闲块和碎片。块头和对齐按 8 字节简化。
+
+#define SIM_DEFAULT_BYTES (8 * 1024 * 1024) // 未调用 heapSimulate() 时
+#define SIM_HEAD          8                 // 块头（大小，空闲时还有下一块）
+#define SIM_MIN_CHUNK     16
+#define SIM_NONE          0xFFFFFFFF
+
+static uint8_t  *simBase = NULL;
+static uint32_t  simSize = 0, simTop = 0, simFreeList = SIM_NONE;
+
+static inline uint32_t &chunkSize(uint32_t c) { return ((uint32_t *)&simBase[c])[0]; }
+static inline uint32_t &chunkNext(uint32_t c) { return ((uint32_t *)&simBase[c])[1]; }
+
+// 设置模拟堆的大小（例如开发板启动时打印的可用 RAM），丢弃之前的所有
+// 分配和统计。在第一次 heapAlloc() 之前调用。
+bool heapSimulate(uint32_t bytes) {
+  free(simBase);
+  if(!(simBase = (uint8_t *)malloc(bytes))) {
+    simSize = 0;
+    return false;
+  }
+  simSize     = bytes & ~7;
+  simTop      = 0;
+  simFreeList = SIM_NONE;
+  memset(live  , 0, sizeof live);
+  memset(peak  , 0, sizeof peak);
+  memset(blocks, 0, sizeof blocks);
+  topPeak     = 0;
+  return true;
+}
+
+static void *rawAlloc(size_t bytes) {
+  if(!simBase && !heapSimulate(SIM_DEFAULT_BYTES)) return NULL;
+  if(bytes > simSize) return NULL;
+  uint32_t need = (((uint32_t)bytes + 7) & ~7) + SIM_HEAD;
+  if(need < SIM_MIN_CHUNK) need = SIM_MIN_CHUNK;
+  uint32_t prev = SIM_NONE;
+  for(uint32_t c = simFreeList; c != SIM_NONE; prev = c, c = chunkNext(c)) {
+    if(chunkSize(c) < need) continue;
+    uint32_t rem = chunkSize(c) - need;
+    if(rem >= SIM_MIN_CHUNK) {   // 空闲块留在原处，分配它的末尾
+      chunkSize(c)  = rem;
+      c            += rem;
+      chunkSize(c)  = need;
+    } else if(prev == SIM_NONE) {
+      simFreeList = chunkNext(c);
+    } else {
+      chunkNext(prev) = chunkNext(c);
+    }
+    return &simBase[c + SIM_HEAD];
+  }
+  if(need > (simSize - simTop)) return NULL; // “堆栈”之前没有空间
+  uint32_t c = simTop;
+  simTop      += need;
+  chunkSize(c) = need;
+  return &simBase[c + SIM_HEAD];
+}
+
+static void rawFree(void *ptr) {
+  if(!ptr) return;
+  uint32_t c = (uint8_t *)ptr - simBase - SIM_HEAD, prev = SIM_NONE, next;
+  for(next = simFreeList; (next != SIM_NONE) && (next < c); prev = next, next = chunkNext(next));
+  chunkNext(c) = next;
+  if((next != SIM_NONE) && ((c + chunkSize(c)) == next)) { // 与后一块合并
+    chunkSize(c) += chunkSize(next);
+    chunkNext(c)  = chunkNext(next);
+  }
+  if(prev == SIM_NONE) {
+    simFreeList = c;
+  } else if((prev + chunkSize(prev)) == c) {               // 与前一块合并
+    chunkSize(prev) += chunkSize(c);
+    chunkNext(prev)  = chunkNext(c);
+  } else {
+    chunkNext(prev) = c;
+  }
+}
+
+static uint32_t heapTop(void) {
+  return simTop;
+}
+
+static void heapWalk(heapStats *s) {
+  uint32_t listBytes = 0;
+  for(uint32_t c = simFreeList; c != SIM_NONE; c = chunkNext(c)) {
+    s->freeBlocks++;
+    listBytes += chunkSize(c);
+    if(chunkSize(c) > s->largestFree) s->largestFree = chunkSize(c);
+  }
+  uint32_t gap = simSize - simTop;
+  s->used      = simTop - listBytes;
+  s->freeBytes = listBytes + gap;
+  if(gap > s->largestFree) s->largestFree = gap;
+}
+
+#endif // ARDUINO
+
+// 分配 'bytes' 字节并记在子系统 'tag' 名下，失败时返回 NULL（与 malloc()
+// 相同）。只能用 heapFree() 释放。
+void *heapAlloc(uint8_t tag, size_t bytes) {
+  heapHeader *h = (heapHeader *)rawAlloc(sizeof(heapHeader) + bytes);
+  if(!h) return NULL;
+  if(tag >= HEAP_TAGS) tag = HEAP_OTHER;
+  h->bytes = bytes;
+  h->tag   = tag;
+  live[tag] += bytes;
+  blocks[tag]++;
+  if(live[tag] > peak[tag]) peak[tag] = live[tag];
+  uint32_t top = heapTop();
+  if(top > topPeak) topPeak = top;
+  return &h[1];
+}
+
+void heapFree(void *ptr) {
+  if(!ptr) return;
+  heapHeader *h = (heapHeader *)ptr - 1;
+  live[h->tag] -= h->bytes;
+  blocks[h->tag]--;
+  rawFree(h);
+}
+
+// true = 现在可以分配 'bytes' 字节（分配后立即释放，不计入统计）
+bool heapFits(size_t bytes) {
+  void *p = rawAlloc(bytes);
+  if(!p) return false;
+  rawFree(p);
+  return true;
+}
+
+void heapGetStats(heapStats *s) {
+  memset(s, 0, sizeof *s);
+  memcpy(s->live  , live  , sizeof live);
+  memcpy(s->peak  , peak  , sizeof peak);
+  memcpy(s->blocks, blocks, sizeof blocks);
+  s->top = topPeak;
+  heapWalk(s);
+}
+
+// 打印堆的情况：总量一行，然后每个用过的子系统一行。碎片率是不在最大
+// 空闲空间中的空闲字节的比例，0% = 所有空闲内存连续。
+void heapReport(const char *phase) {
+  heapStats s;
+  heapGetStats(&s);
+  int frag = s.freeBytes ? (int)(100 - (uint64_t)s.largestFree * 100 / s.freeBytes) : 0;
+  heapPrintf("堆（%s）：已用 %d 字节，堆顶峰值 %d，空闲 %d 字节（中间 %d 块），"
+    "最大空闲 %d 字节，碎片 %d%%\n", phase, (int)s.used, (int)s.top,
+    (int)s.freeBytes, s.freeBlocks, (int)s.largestFree, frag);
+  uint32_t tagged = 0;
+  for(int t=0; t<HEAP_TAGS; t++) {
+    tagged += s.live[t];
+    if(!s.peak[t]) continue;
+    heapPrintf("  %s: %d 字节（%d 块），峰值 %d\n", tagName[t],
+      (int)s.live[t], s.blocks[t], (int)s.peak[t]);
+  }
+  if(s.used > tagged) {
+    heapPrintf("  未标记和块头: %d 字节\n", (int)(s.used - tagged));
+  }
+}
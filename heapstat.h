@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 堆的使用情况统计。availableRAM() 只报告堆顶（sbrk(0)）和堆栈之间的
+// 空间：释放回堆中间的内存不计算在内，也看不出碎片。程序自己的分配用
+// heapAlloc() 和 heapFree() 代替 malloc() 和 free()，按子系统（HEAP_*）
+// 记录当前字节数和峰值；heapReport() 另外遍历空闲块列表，报告空闲总量、
+// 最大的连续空闲空间和碎片率。
+// 与 render.h 一样不依赖开发板专用的库。在主机上，分配来自一个模拟
+// newlib-nano malloc 的堆（见 heapstat.cpp），tools/heapreplay 用它按
+// setup() 的顺序重放一个预设的分配，在烧录之前发现碎片问题。
+
+#ifndef __HEAPSTAT_H
+#define __HEAPSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEAP_OTHER    0 // 未指定子系统
+#define HEAP_TABLES   1 // 极坐标地图和位移映射（tablegen.cpp）
+#define HEAP_TEXTURES 2 // 调色板、块布局的地址表和 SRAM 中的纹理
+#define HEAP_VOICE    3 // 语音变调的缓冲区（pdmvoice.cpp）
+#define HEAP_USER     4 // user*.cpp
+#define HEAP_LOAD     5 // 加载阶段的区域和 JSON 文档（见 memory.cpp）
+#define HEAP_COLUMNS  6 // 列环形缓冲区中静态的两个之外的列结构（M4_Eyes.ino）
+#define HEAP_TAGS     7
+
+typedef struct {
+  uint32_t live[HEAP_TAGS];   // 每个子系统当前分配的字节数（请求的大小）
+  uint32_t peak[HEAP_TAGS];   // 每个子系统的峰值
+  uint16_t blocks[HEAP_TAGS]; // 每个子系统当前的块数
+  uint32_t used;              // 堆中已分配的字节，包括块头和未标记的分配
+  uint32_t top;               // 堆顶的峰值（从堆的开始算起）
+  uint32_t freeBytes;         // 空闲块加上堆顶到堆栈的空间
+  uint32_t largestFree;       // 最大的连续空闲空间
+  uint16_t freeBlocks;        // 堆中间的空闲块数
+} heapStats;
+
+extern void *heapAlloc(uint8_t tag, size_t bytes);
+extern void  heapFree(void *ptr);
+extern bool  heapFits(size_t bytes);
+extern void  heapGetStats(heapStats *s);
+extern void  heapReport(const char *phase);
+#if !defined(ARDUINO)
+extern bool  heapSimulate(uint32_t bytes);
+#endif
+
+#endif // __HEAPSTAT_H
@@ -0,0 +1,377 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+#include "globals.h"
+
+// 将纹理等数据写入程序之后未使用的内部闪存。闪存按页（512 字节）写入，
+// 按块（8 KB）擦除，所以数据通过一个页大小的缓冲区流式写入：调用者
+// 可以分小块提供数据（例如从文件读取），不需要整个对象在 RAM 中。
+// 每个对象从新的一块开始：同样的对象按同样的顺序写入时，每次启动都在
+// 同一地址，加载函数可以用 flashPeek() 检查上次启动写入的内容是否仍然
+// 可用，并用 flashSkip() 保留它，而擦除下一个对象时不会碰到它（见
+// file.cpp 中的纹理闪存缓存）。所有写入都通过这里进行，以免两个写入者
+// 使用同一块闪存。
+
+#define FLASH_PAGE_BYTES  512
+#define FLASH_BLOCK_BYTES 8192
+
+extern uint32_t __etext;                          // 链接器脚本：程序代码的末尾，
+extern uint32_t __data_start__, __data_end__;     // 之后是 .data 的初始值
+
+static uint32_t flashNext   = 0; // 下一个对象的地址（页对齐），0 = 尚未初始化
+static uint32_t flashErased = 0; // 已擦除区域的末尾（块对齐）
+static uint32_t flashAddr;       // 当前对象中下一页的地址
+static uint8_t *flashStart;      // 当前对象的开始
+static bool     flashError;      // 当前对象写入失败（闪存已满）
+static uint16_t pageFill;        // pageBuf 中的字节数
+static uint32_t pageBuf[FLASH_PAGE_BYTES / 4];
+
+static void flashInit(void) {
+  if(flashNext) return;
+  uint32_t end = (uint32_t)&__etext +
+    ((uint32_t)&__data_end__ - (uint32_t)&__data_start__);
+  flashNext = flashErased = (end + FLASH_BLOCK_BYTES - 1) & ~(FLASH_BLOCK_BYTES - 1);
+}
+
+static inline void nvmWait(void) {
+  while(!NVMCTRL->STATUS.bit.READY);
+}
+
+static void nvmCommand(uint16_t cmd) {
+  NVMCTRL->CTRLB.reg = NVMCTRL_CTRLB_CMDEX_KEY | cmd;
+  nvmWait();
+}
+
+// 写入一页（必要时先擦除下一块），然后使 CMCC 中可能过时的行失效
+static bool flashWritePage(uint32_t addr, const uint32_t *src) {
+  if((addr + FLASH_PAGE_BYTES) > FLASH_SIZE) return false;
+  uint16_t ctrla = NVMCTRL->CTRLA.reg;
+  NVMCTRL->CTRLA.reg = (ctrla & ~NVMCTRL_CTRLA_WMODE_Msk) | NVMCTRL_CTRLA_WMODE_MAN |
+    NVMCTRL_CTRLA_CACHEDIS0 | NVMCTRL_CTRLA_CACHEDIS1;
+  nvmWait();
+  while(addr >= flashErased) {
+    NVMCTRL->ADDR.reg = flashErased;
+    nvmCommand(NVMCTRL_CTRLB_CMD_EB);
+    flashErased += FLASH_BLOCK_BYTES;
+  }
+  nvmCommand(NVMCTRL_CTRLB_CMD_PBC);               // 清除页缓冲区
+  volatile uint32_t *dst = (volatile uint32_t *)addr;
+  for(uint16_t i=0; i<(FLASH_PAGE_BYTES / 4); i++) dst[i] = src[i];
+  NVMCTRL->ADDR.reg = addr;
+  nvmCommand(NVMCTRL_CTRLB_CMD_WP);
+  NVMCTRL->CTRLA.reg = ctrla;
+
+  if(CMCC->SR.bit.CSTS) { // 缓存已启用：使所有行失效
+    CMCC->CTRL.bit.CEN = 0;
+    while(CMCC->SR.bit.CSTS);
+    CMCC->MAINT0.reg = CMCC_MAINT0_INVALL;
+    CMCC->CTRL.bit.CEN = 1;
+  }
+  return true;
+}
+
+// 下一个对象将开始的位置（块对齐）
+static uint32_t flashObjectStart(void) {
+  flashInit();
+  return (flashNext + FLASH_BLOCK_BYTES - 1) & ~(FLASH_BLOCK_BYTES - 1);
+}
+
+// 开始一个新的闪存对象，返回它在闪存中的地址（数据在 flashStreamEnd()
+// 之后才全部有效）。
+uint8_t *flashStreamBegin(void) {
+  flashNext  = flashObjectStart();
+  flashAddr  = flashNext;
+  flashStart = (uint8_t *)flashAddr;
+  flashError = false;
+  pageFill   = 0;
+  return flashStart;
+}
+
+// 将 'len' 字节追加到当前对象。如果闪存已满返回 false。
+bool flashStreamWrite(const void *src, uint32_t len) {
+  const uint8_t *s = (const uint8_t *)src;
+  while(len && !flashError) {
+    uint32_t n = FLASH_PAGE_BYTES - pageFill;
+    if(n > len) n = len;
+    memcpy((uint8_t *)pageBuf + pageFill, s, n);
+    pageFill += n;
+    s        += n;
+    len      -= n;
+    if(pageFill == FLASH_PAGE_BYTES) {
+      if(flashWritePage(flashAddr, pageBuf)) flashAddr += FLASH_PAGE_BYTES;
+      else                                   flashError = true;
+      pageFill = 0;
+    }
+  }
+  return !flashError;
+}
+
+// 写出最后的部分页并结束当前对象。返回对象的地址，失败时返回 NULL。
+// 即使失败，已写入的页也不能再写（闪存只有擦除后才能重写），
+// 所以下一个对象总是从这里之后开始。
+uint8_t *flashStreamEnd(void) {
+  if(pageFill && !flashError) {
+    memset((uint8_t *)pageBuf + pageFill, 0xFF, FLASH_PAGE_BYTES - pageFill);
+    if(flashWritePage(flashAddr, pageBuf)) flashAddr += FLASH_PAGE_BYTES;
+    else                                   flashError = true;
+  }
+  pageFill  = 0;
+  flashNext = flashAddr;
+  return flashError ? NULL : flashStart;
+}
+
+// 一次性将 RAM 中的数据写入闪存
+uint8_t *writeDataToFlash(uint8_t *src, uint32_t len) {
+  flashStreamBegin();
+  flashStreamWrite(src, len);
+  return flashStreamEnd();
+}
+
+// 下一个对象将开始的地址，其中可能是上次启动时写入的数据（或擦除后的 0xFF）
+const uint8_t *flashPeek(void) {
+  return (const uint8_t *)flashObjectStart();
+}
+
+// 把 flashPeek() 处已有的 'len' 字节作为一个对象保留，不重写。
+// 调用者已检查过内容和 availableNVM()。
+void flashSkip(uint32_t len) {
+  flashNext = flashObjectStart() + len;
+  // 这些块保存着有效数据，不能为下一个对象擦除
+  uint32_t end = (flashNext + FLASH_BLOCK_BYTES - 1) & ~(FLASH_BLOCK_BYTES - 1);
+  if(end > flashErased) flashErased = end;
+}
+
+// 剩余的闪存字节数（从下一个对象开始）
+uint32_t availableNVM(void) {
+  uint32_t start = flashObjectStart();
+  return (start < FLASH_SIZE) ? (FLASH_SIZE - start) : 0;
+}
+
+// 加载阶段的内存区域 -----------------------------------------------------
+
+// 加载配置、纹理和眼睑时的临时内存（JSON 文档、文件名、调色板和块布局的
+// 行缓冲区）都从一个区域中顺序分配（arenaAlloc()），用 arenaMark() 和
+// arenaReset() 按后进先出的顺序归还，加载结束时用 arenaEnd() 一次全部
+// 释放。加载阶段没有其他长期存在的堆分配（纹理的调色板和地址表之后由
+// finishTextures() 分配），所以释放区域之后堆回到加载之前的状态，之后
+// 生成的表得到一块连续的内存。只有 Adafruit_ImageReader（其他 BMP 格式
+// 的后备）仍然自己分配内存。
+
+#define LOAD_ARENA_BYTES 16384
+
+static uint8_t  *arenaBase = NULL;
+static uint32_t  arenaSize = 0;
+static uint32_t  arenaUsed = 0;
+
+// 分配区域。失败时 arenaAlloc() 总是返回 NULL，调用者使用各自的后备方案。
+bool arenaBegin(void) {
+  if(!arenaBase && (arenaBase = (uint8_t *)heapAlloc(HEAP_LOAD, LOAD_ARENA_BYTES))) {
+    arenaSize = LOAD_ARENA_BYTES;
+  }
+  arenaUsed = 0;
+  return arenaBase != NULL;
+}
+
+// 从区域中分配 'bytes' 字节（4 字节对齐），区域已满或不存在时返回 NULL
+void *arenaAlloc(uint32_t bytes) {
+  bytes = (bytes + 3) & ~3;
+  if(!arenaBase || (bytes > (arenaSize - arenaUsed))) return NULL;
+  void *p = &arenaBase[arenaUsed];
+  arenaUsed += bytes;
+  return p;
+}
+
+// 把字符串复制到区域中（在 arenaEnd() 时释放）
+char *arenaStrdup(const char *str) {
+  char *p = (char *)arenaAlloc(strlen(str) + 1);
+  if(p) strcpy(p, str);
+  return p;
+}
+
+// true = p 在区域中（不能用 free() 释放）
+bool arenaOwns(const void *p) {
+  return arenaBase && ((const uint8_t *)p >= arenaBase) &&
+    ((const uint8_t *)p < &arenaBase[arenaSize]);
+}
+
+// arenaMark() 之后分配的内存可以用 arenaReset() 一起归还
+uint32_t arenaMark(void) {
+  return arenaUsed;
+}
+
+void arenaReset(uint32_t mark) {
+  if(mark < arenaUsed) arenaUsed = mark;
+}
+
+// 加载阶段结束：释放整个区域。之前从区域分配的指针都不再有效。
+void arenaEnd(void) {
+  heapFree(arenaBase);
+  arenaBase = NULL;
+  arenaSize = arenaUsed = 0;
+}
+
+// 纹理驻留 ---------------------------------------------------------------
+
+// 纹理可以放在三种存储器中。SRAM 没有等待状态。内部闪存经过 CMCC 缓存，
+// 未命中时有等待状态。QSPI 闪存（文件系统所在）内存映射后也可以直接读取，
+// 容量大得多，但每次读取都要经过 QSPI 总线，比内部闪存慢。纹理按优先级
+// （config.eye 中的 "irisPriority" 和 "scleraPriority"；默认虹膜 2、巩膜 1，
+// 因为虹膜通常较小，每字节被采样的次数更多）得到更快的存储器：
+//  - setup() 按优先级顺序加载纹理，所以优先级高的纹理先得到内部闪存。
+//    内部闪存放不下的 .tex 文件如果在文件系统中连续存储，就直接从 QSPI
+//    读取（见 file.cpp 中的 loadTex()）。
+//  - 表生成之后，placeTextures() 按优先级把纹理复制到剩余的 RAM 中，
+//    每次都保留 stackReserve 字节。优先级 0 的纹理不复制。内部闪存中的
+//    副本不回收（闪存只在加载时写入）。
+
+static bool qspiTextures = false; // 有纹理从 QSPI 读取
+
+// 按优先级从高到低列出所有眼睛的纹理（优先级相同时按眼睛顺序，虹膜在
+// 巩膜之前）。list 至少有 NUM_EYES * 2 项。返回纹理数。
+int texturesByPriority(texture **list) {
+  int n = 0;
+  for(uint8_t e=0; e<NUM_EYES; e++) {
+    texture *t[2] = { &eye[e].iris, &eye[e].sclera };
+    for(uint8_t i=0; i<2; i++) { // 插入排序，保持相同优先级的顺序
+      int j = n++;
+      for(; (j > 0) && (list[j-1]->priority < t[i]->priority); j--) list[j] = list[j-1];
+      list[j] = t[i];
+    }
+  }
+  return n;
+}
+
+// 纹理的像素（索引纹理为索引）
+static inline uint8_t *texturePixels(const texture *t) {
+  return t->index ? t->index : (uint8_t *)t->data;
+}
+
+// 加载阶段结束（arenaEnd()）之后、生成表之前调用：把索引纹理的调色板
+// 从闪存（或 QSPI）复制到 RAM，为块布局的纹理生成地址表。这些是纹理
+// 一直需要的 RAM，在加载阶段之后分配，以免夹在加载时的临时内存之间。
+// RAM 不足时纹理改为纯色（闪存中的数据是块布局，没有地址表无法读取）。
+void finishTextures(void) {
+  texture *list[NUM_EYES * 2];
+  int      n = texturesByPriority(list);
+
+  for(int i=0; i<n; i++) {
+    if(list[i]->tier == TIER_QSPI) qspiTextures = true;
+  }
+  qspiMapTextures(); // 读取调色板之前 QSPI 必须处于内存映射模式
+
+  for(int i=0; i<n; i++) {
+    texture *t = list[i];
+    if(t->tier == TIER_NONE) continue;
+    int j;
+    for(j=0; (j < i) && (texturePixels(list[j]) != texturePixels(t)); j++);
+    if(j < i) { // 与之前的纹理共享像素，也共享调色板和地址表
+      t->data       = list[j]->data;
+      t->tileHeight = list[j]->tileHeight;
+      t->rowOffset  = list[j]->rowOffset;
+      t->colOffset  = list[j]->colOffset;
+      continue;
+    }
+    uint16_t *palette = NULL;
+    if(t->index && (palette = (uint16_t *)heapAlloc(HEAP_TEXTURES, 256 * sizeof(uint16_t)))) {
+      memcpy(palette, t->data, 256 * sizeof(uint16_t)); // 可以在运行时改写
+    }
+    if((t->index && !palette) || (t->tileHeight && !prepareTiles(t))) {
+      heapFree(palette);
+      Serial.println("纹理的调色板或地址表 RAM 不足，改为纯色");
+      t->data       = &t->color;
+      t->index      = NULL;
+      t->width      = t->height = 1;
+      t->tileHeight = 0;
+      t->tier       = TIER_NONE;
+      continue;
+    }
+    if(palette) t->data = palette;
+  }
+}
+
+// 表生成之后调用：把纹理按优先级复制到剩余的 RAM 中，并通过串口报告
+// 每个纹理所在的存储器。
+void placeTextures(void) {
+  static const char *tierName[] = { "纯色", "SRAM", "内部闪存", "QSPI" };
+  texture *list[NUM_EYES * 2];
+  uint32_t total[4] = { 0 };
+  int      n = texturesByPriority(list);
+
+  qspiMapTextures(); // 复制之前 QSPI 必须处于内存映射模式（表缓存可能访问了文件系统）
+
+  for(int i=0; i<n; i++) {
+    texture *t = list[i];
+    uint8_t  e;
+    for(e=0; (e < NUM_EYES) && (t != &eye[e].iris) && (t != &eye[e].sclera); e++);
+    const char *kind = (t == &eye[e].iris) ? "虹膜" : "巩膜";
+    if(t->tier == TIER_NONE) {
+      Serial.printf("眼睛 #%d %s：纯色\n", e, kind);
+      continue;
+    }
+    int j;
+    for(j=0; (j < i) && (texturePixels(list[j]) != texturePixels(t)); j++);
+    if(j < i) {
+      Serial.printf("眼睛 #%d %s：与前一个相同，%s\n", e, kind, tierName[t->tier]);
+      continue;
+    }
+
+    uint32_t bytes = textureBytes(t);
+    uint8_t *src   = texturePixels(t);
+    if(t->priority && (t->tier != TIER_SRAM)) {
+      uint8_t *ram;
+      if(heapFits(bytes + stackReserve) && // 放得下，并且留出余量？
+         (ram = (uint8_t *)heapAlloc(HEAP_TEXTURES, bytes))) {
+        memcpy(ram, src, bytes);
+        for(int k=i; k<n; k++) { // 共享这个纹理的眼睛也改用 RAM 中的副本
+          if(texturePixels(list[k]) != src) continue;
+          if(list[k]->index) list[k]->index = ram;
+          else               list[k]->data  = (uint16_t *)ram;
+          list[k]->tier = TIER_SRAM;
+        }
+      }
+    }
+    total[t->tier] += bytes;
+    Serial.printf("眼睛 #%d %s：%dx%d%s%s，%d 字节，优先级 %d，%s\n", e, kind,
+      t->width, t->height, t->index ? "，8 位索引" : "", t->tileHeight ? "，块布局" : "",
+      (int)bytes, t->priority, tierName[t->tier]);
+  }
+  Serial.printf("纹理：SRAM %d 字节，内部闪存 %d 字节，QSPI %d 字节\n",
+    (int)total[TIER_SRAM], (int)total[TIER_FLASH], (int)total[TIER_QSPI]);
+}
+
+#if defined(ARCADA_USE_QSPI_FS)
+
+// QSPI 闪存中文件系统扇区 'sector'（512 字节）内偏移 'offset' 处的
+// 内存映射地址。文件系统从闪存的开头开始，没有分区表。
+uint8_t *qspiAddress(uint32_t sector, uint32_t offset) {
+  return (uint8_t *)QSPI_AHB + sector * 512 + offset;
+}
+
+// 把 QSPI 设置为内存映射读取（四线输出快速读取，与 Adafruit_SPIFlash
+// 读取这些电路板的闪存时相同）。文件系统的每次访问都会改变 QSPI 的指令
+// 设置，所以在文件系统可能被访问之后、读取纹理之前调用：placeTextures()
+// 中，以及每次 loop() 的开头（USB 大容量存储在 loop() 的两次调用之间访问
+// 闪存）。没有纹理在 QSPI 中时不做任何事。
+void qspiMapTextures(void) {
+  if(!qspiTextures) return;
+  QSPI->INSTRCTRL.bit.INSTR = 0x6B; // 四线输出快速读取
+  QSPI->INSTRFRAME.reg = QSPI_INSTRFRAME_WIDTH_QUAD_OUTPUT |
+    QSPI_INSTRFRAME_ADDRLEN_24BITS | QSPI_INSTRFRAME_INSTREN |
+    QSPI_INSTRFRAME_ADDREN | QSPI_INSTRFRAME_DATAEN |
+    QSPI_INSTRFRAME_TFRTYPE_READMEMORY | QSPI_INSTRFRAME_DUMMYLEN(8);
+  (void)QSPI->INSTRFRAME.reg; // 读回，确保设置在下一次读取之前生效
+}
+
+#else
+
+uint8_t *qspiAddress(uint32_t sector, uint32_t offset) {
+  return NULL; // 文件系统不在 QSPI 闪存上
+}
+
+void qspiMapTextures(void) {
+}
+
+#endif // ARCADA_USE_QSPI_FS
@@ -73,15 +73,15 @@ float voicePitch(float p); // 设置音高
 bool voiceSetup(bool modEnable) {
 
   // 为音频分配循环缓冲区
-  if(NULL == (recBuf = (uint16_t *)malloc(recBufSize * sizeof(uint16_t)))) {
+  if(NULL == (recBuf = (uint16_t *)heapAlloc(HEAP_VOICE, recBufSize * sizeof(uint16_t)))) {
     return false; // 失败
   }
 
   // 如果启用，为语音调制分配缓冲区
   if(modEnable) {
     // 250 来自 voicePitch() 中的最小周期
-    modBuf = (uint8_t *)malloc((int)(48000000.0 / 250.0 / MOD_MIN + 0.5));
-    // 如果 malloc 失败，程序将继续运行，但没有调制
+    modBuf = (uint8_t *)heapAlloc(HEAP_VOICE, (int)(48000000.0 / 250.0 / MOD_MIN + 0.5));
+    // 如果分配失败，程序将继续运行，但没有调制
   }
 
   pdmspi.begin(sampleRate);  // 设置 PDM 麦克风
@@ -0,0 +1,517 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+#include "render.h"
+#include "heapstat.h"
+
+// 此文件中的代码将眼睛的一列渲染到调用者提供的缓冲区中。
+// 它只使用传入的表和眼睛状态快照，不访问任何全局变量，
+// 因此可以在开发板上（由 loop() 调用）和主机上（tools/eyebench）使用。
+
+// 以前每个像素都要依次测试：是否在眼球内、是否在极坐标地图内、
+// 位于地图的哪个象限。但在一列之内，这些测试的结果只在少数几个点改变：
+// 眼球是一个圆，所以眼球外的像素只出现在列的两端；在屏幕的上半部分
+// 或下半部分之内，位移映射是单调的（tablegen.cpp 生成的位移随到中心的
+// 距离增加），所以地图坐标 mx 和 my 都随 y 单调变化，每个地图边界
+// （0、mapRadius、mapDiameter）最多被穿过一次。因此每列先用二分查找
+// 找出这些边界，把列分成若干段（眼球外、超出地图、每个象限一段），
+// 然后每段用一个没有几何分支的紧凑循环渲染。
+
+// 一列中屏幕半部分（上或下）的不变量
+typedef struct {
+  const uint8_t *displaceX; // 此列的 X 位移（步长为 half）
+  const uint8_t *displaceY; // 此列的 Y 位移（步长为 1）
+  int            half;      // 屏幕尺寸的一半
+  int            xx;        // 此列在地图上的 X 位置（位移前）
+  int            yPosition; // 屏幕底部在地图上的 Y 位置
+  int            xmul;      // X 位移的符号：+1 或 -1
+  int            dstep;     // +1 = 上半部分，-1 = 下半部分（也是 Y 位移的符号）
+  int            dbase;     // doff = dbase + dstep * y
+} columnHalf;
+
+// 像素 y 在极坐标地图上的坐标（象限选择之前）
+static inline int mapX(const columnHalf *c, int y) {
+  return c->xx + c->xmul * c->displaceX[(c->dbase + c->dstep * y) * c->half];
+}
+static inline int mapY(const columnHalf *c, int y) {
+  return c->yPosition + y + c->dstep * c->displaceY[c->dbase + c->dstep * y];
+}
+
+// 在 [ya, yb] 中查找 (坐标 >= t) 的结果第一次改变的 y。坐标在半列之内单调，
+// 所以结果最多改变一次。如果不改变则返回 yb + 1。
+static int findSplit(const columnHalf *c, bool axisY, int t, int ya, int yb) {
+  bool first = (axisY ? mapY(c, ya) : mapX(c, ya)) >= t;
+  bool last  = (axisY ? mapY(c, yb) : mapX(c, yb)) >= t;
+  if(first == last) return yb + 1;
+  int lo = ya, hi = yb; // 不变量：lo 处为 first，hi 处为 last
+  while((hi - lo) > 1) {
+    int mid = (lo + hi) / 2;
+    if(((axisY ? mapY(c, mid) : mapX(c, mid)) >= t) == first) lo = mid;
+    else                                                       hi = mid;
+  }
+  return hi;
+}
+
+// 着色所需的值，每列从 eyeRenderState 和纹理中复制一次。
+// 复制到局部变量很重要：输出指针是 uint16_t *，编译器无法证明
+// 写入它不会改变 texture 中的 uint16_t 字段，否则每个像素都要重新读取。
+typedef struct {
+  const uint16_t *irisData;                // 像素，索引纹理则为调色板
+  const uint16_t *scleraData;
+  const uint8_t  *irisIndex, *scleraIndex; // 索引纹理的像素，否则为 NULL
+  const uint32_t *irisRow, *scleraRow;     // 块布局的地址表，
+  const uint16_t *irisCol, *scleraCol;     // 逐行存储的纹理为 NULL
+  int             irisWidth, irisHeight, irisAngle, irisMirror;
+  int             scleraWidth, scleraHeight, scleraAngle, scleraMirror;
+  int             irisBits, irisShift;     // log2(宽度) 和 10 - log2(宽度)，
+  int             scleraBits, scleraShift; // 仅用于 RENDER_POW2
+  int             iPupilFactor;
+  int             pupilDist;               // -dist >= 此值为瞳孔
+  uint16_t        irisColor, scleraColor, pupilColor, backColor;
+  colorRuns      *runs;                    // eyeRenderState.runs
+  bool            pupilRuns;               // true = 查找瞳孔的纯色段
+} shadeState;
+
+// 纹理中第 i 个像素的颜色。索引纹理先读 8 位索引，再查调色板；
+// 纹理是否为索引在一列之内不变，所以这个分支每次都走同一边。
+// 没有索引纹理的眼睛（RENDER_INDEXED 未设置）完全没有这个分支。
+#if defined(RENDER_TRACE)
+// tools/texcache 用 -DRENDER_TRACE 编译此文件，记录每次从闪存读取纹理的
+// 地址和字节数，以模拟 CMCC 缓存。固件和 eyebench 中没有此调用。
+extern void renderTrace(const void *addr, int bytes);
+#endif
+
+template<int F>
+static inline uint16_t texel(const uint16_t *data, const uint8_t *index, int i) {
+#if defined(RENDER_TRACE)
+  if((F & RENDER_INDEXED) && index) renderTrace(&index[i], 1);
+  else                              renderTrace(&data[i] , 2);
+#endif
+  if((F & RENDER_INDEXED) && index) return data[index[i]];
+  return data[i];
+}
+
+// 将极坐标地图中的角度/距离转换为像素颜色（巩膜、虹膜、瞳孔或眼睛背面）。
+// 未纹理化（纯色）的虹膜或巩膜完全跳过纹理采样；
+// 未镜像的眼睛跳过镜像 XOR。逐像素路径中没有除法：角度（0-1023）
+// 和距离（0-127）都是非负的，所以 / 1024 和 / 128 就是移位；纹理宽度
+// 为 2 的幂时（RENDER_POW2），乘以宽度也变成移位。块布局的纹理
+// （RENDER_TILED）用两个地址表代替乘法，和索引纹理一样，每个纹理
+// 是否为块布局在一列之内不变。
+template<int F>
+static inline uint16_t shade(const shadeState &s, int angle, int dist) {
+  if(dist >= 0) { // 巩膜
+    if(!(F & RENDER_SCLERA_TEXTURE)) return s.scleraColor;
+    angle = (angle + s.scleraAngle) & 1023;
+    if(F & RENDER_MIRROR) angle ^= s.scleraMirror;
+    int ty = (dist * s.scleraHeight) >> 7; // 纹理贴图 y
+    if((F & RENDER_TILED) && s.scleraRow) {
+      return texel<F>(s.scleraData, s.scleraIndex, s.scleraRow[ty] + s.scleraCol[angle]);
+    }
+    if(F & RENDER_POW2) {
+      return texel<F>(s.scleraData, s.scleraIndex,
+        (ty << s.scleraBits) + (angle >> s.scleraShift));
+    }
+    int tx = (angle * s.scleraWidth) >> 10; // 纹理贴图 x
+    return texel<F>(s.scleraData, s.scleraIndex, ty * s.scleraWidth + tx);
+  } else if(dist > -128) { // 虹膜或瞳孔
+    dist = -dist;
+    if(dist >= s.pupilDist) return s.pupilColor; // 瞳孔
+    if(!(F & RENDER_IRIS_TEXTURE)) return s.irisColor;
+    int ty = (dist * s.iPupilFactor) >> 15;
+    angle = (angle + s.irisAngle) & 1023;
+    if(F & RENDER_MIRROR) angle ^= s.irisMirror;
+    if((F & RENDER_TILED) && s.irisRow) {
+      return texel<F>(s.irisData, s.irisIndex, s.irisRow[ty] + s.irisCol[angle]);
+    }
+    if(F & RENDER_POW2) {
+      return texel<F>(s.irisData, s.irisIndex,
+        (ty << s.irisBits) + (angle >> s.irisShift));
+    }
+    int tx = (angle * s.irisWidth) >> 10;
+    return texel<F>(s.irisData, s.irisIndex, ty * s.irisWidth + tx);
+  }
+  return s.backColor; // 眼睛背面
+}
+
+// 第一象限坐标 (x, y) 处的地图条目，角度为 0-255。O = 地图按八分圆存储
+// （见 calcMap()）：对角线以上的点在对角线上镜像，角度变为 255 - 角度。
+template<bool O>
+static inline polarEntry polarLookup(const polarEntry *polar, int R, int x, int y) {
+  if(!O) return polar[x * R + y];
+  int swap = (y > x);
+  int hi   = swap ? y : x; // 条件执行，没有分支
+  int lo   = swap ? x : y;
+  polarEntry e = polar[((hi * (hi + 1)) >> 1) + lo];
+  e.angle ^= (uint8_t)-swap;
+  return e;
+}
+
+// 从 y 开始的 n 个 'color' 像素。记录纯色段（'runs' 非 NULL）时，如果
+// 段足够长、颜色可以用一个字节发出并且还有空位，或者紧接着前一个同类
+// 的段，记录下来，不写入；否则照常写入。返回 ptr + n。
+static uint16_t *fillRun(colorRuns *runs, uint8_t kind, uint16_t color,
+  int y, int n, uint16_t *ptr) {
+  if(n <= 0) return ptr;
+  if(runs) {
+    colorRun *r = runs->count ? &runs->run[runs->count - 1] : NULL;
+    if(r && (r->kind == kind) && ((r->y + r->count) == y)) {
+      r->count += n; // 与前一个段合并（例如瞳孔跨过屏幕的两个半部分）
+      return ptr + n;
+    }
+    if((n >= RUN_MIN) && ((color >> 8) == (color & 0xFF)) && (runs->count < MAX_RUNS)) {
+      r        = &runs->run[runs->count++];
+      r->y     = y;
+      r->count = n;
+      r->kind  = kind;
+      return ptr + n;
+    }
+  }
+  for(int i=0; i<n; i++) *ptr++ = color;
+  return ptr;
+}
+
+// 渲染完全位于一个地图象限内的段 [ya, yb]。Q 是编译时常量，
+// 因此每个象限都得到自己的循环，没有逐像素的象限测试。
+template<int F, int Q, bool O>
+static void renderSpanT(const eyeTables *tables, const shadeState *sp,
+  const columnHalf *c, int ya, int yb, uint16_t *ptr) {
+  const shadeState  s         = *sp; // 局部副本，见上文
+  const int         R         = tables->mapRadius;
+  const polarEntry *polar     = tables->polar;
+  const uint8_t    *displaceX = c->displaceX;
+  const uint8_t    *displaceY = c->displaceY;
+  const int         half      = c->half;
+  const int         dstep     = c->dstep;
+  const int         xmul      = c->xmul;
+  int               doff      = c->dbase + dstep * ya;
+  int               mxBase    = c->xx;
+  int               myBase    = c->yPosition;
+  int               mx, my, angle;
+  polarEntry        e;
+
+  // 地图只存储第一象限（或其中的八分圆），按列存储。每个象限都把 (mx, my)
+  // 镜像到第一象限再查表，所以沿屏幕的一列，所有象限都顺序读取表
+  // （象限 3 和 4 反向）。镜像后的角度：在 X 轴上镜像为 1023 - a（象限 2），
+  // 在 Y 轴上镜像为 511 - a（象限 4），两者都镜像为 512 + a（象限 3）。
+  for(int y=ya; y<=yb; y++, doff += dstep) {
+    mx = mxBase + xmul * displaceX[doff * half];
+    my = myBase + y + dstep * displaceY[doff];
+    if(Q == 1) {
+      e     = polarLookup<O>(polar, R, mx - R, my - R);
+      angle = e.angle;
+    } else if(Q == 2) {
+      e     = polarLookup<O>(polar, R, R - 1 - mx, my - R);
+      angle = 1023 - e.angle;
+    } else if(Q == 3) {
+      e     = polarLookup<O>(polar, R, R - 1 - mx, R - 1 - my);
+      angle = 512 + e.angle;
+    } else {
+      e     = polarLookup<O>(polar, R, mx - R, R - 1 - my);
+      angle = 511 - e.angle;
+    }
+    *ptr++ = shade<F>(s, angle, e.dist);
+  }
+}
+
+template<int F, int Q>
+static inline void renderSpan(const eyeTables *tables, const shadeState *s,
+  const columnHalf *c, int ya, int yb, uint16_t *ptr) {
+  if(tables->octant) renderSpanT<F, Q, true >(tables, s, c, ya, yb, ptr);
+  else               renderSpanT<F, Q, false>(tables, s, c, ya, yb, ptr);
+}
+
+// 象限 Q 中像素 y 在瞳孔内的深度：-dist - pupilDist，>= 0 为瞳孔（与
+// shade() 中的测试相同）；不在虹膜或瞳孔中时为负。
+template<int Q, bool O>
+static inline int pupilDepth(const eyeTables *tables, const columnHalf *c, int pupilDist, int y) {
+  const int R  = tables->mapRadius;
+  int       mx = mapX(c, y), my = mapY(c, y);
+  polarEntry e;
+  if(Q == 1)      e = polarLookup<O>(tables->polar, R, mx - R, my - R);
+  else if(Q == 2) e = polarLookup<O>(tables->polar, R, R - 1 - mx, my - R);
+  else if(Q == 3) e = polarLookup<O>(tables->polar, R, R - 1 - mx, R - 1 - my);
+  else            e = polarLookup<O>(tables->polar, R, mx - R, R - 1 - my);
+  return ((e.dist < 0) && (e.dist > -128)) ? (-e.dist - pupilDist) : -1;
+}
+
+// 瞳孔内部的深度下限。地图上的距离是量化的，瞳孔边缘附近的像素可能交替
+// 是瞳孔和虹膜（缝隙瞳孔的列可能沿着边缘擦过），只有距离边缘至少这么远
+// 的采样点才用来确定内部。
+#define PUPIL_MARGIN 4
+
+// 查找象限段 [ya, yb] 中的瞳孔像素 [*pa, *pb]。一列在地图上是一条单调、
+// 几乎笔直的曲线，沿着它到地图中心的距离是凸的，所以两个深入瞳孔内部的
+// 点之间的像素都是瞳孔：每 RUN_MIN 个像素采样一次，找到连续的深入内部的
+// 采样点，然后从两端逐个像素向外检查，边缘附近的像素都经过与 shade() 相同
+// 的测试。更短或只在边缘附近的瞳孔找不到，照常渲染（结果相同）。
+// 这些额外的地图查找在主机上比省去的瞳孔像素（不读纹理）更慢（eyebench
+// -P 与 -r），所以只在 eyeRenderState.pupilRuns 时使用。
+template<int Q, bool O>
+static bool findPupilT(const eyeTables *tables, const shadeState *s,
+  const columnHalf *c, int ya, int yb, int *pa, int *pb) {
+  const int d = s->pupilDist;
+  int       y, last;
+  for(y=ya; (y <= yb) && (pupilDepth<Q, O>(tables, c, d, y) < PUPIL_MARGIN); y += RUN_MIN);
+  if(y > yb) return false;
+  for(last=y; ((last + RUN_MIN) <= yb) &&
+    (pupilDepth<Q, O>(tables, c, d, last + RUN_MIN) >= PUPIL_MARGIN); last += RUN_MIN);
+  while((y > ya) && (pupilDepth<Q, O>(tables, c, d, y - 1) >= 0)) y--;
+  while((last < yb) && (pupilDepth<Q, O>(tables, c, d, last + 1) >= 0)) last++;
+  *pa = y;
+  *pb = last;
+  return true;
+}
+
+// 渲染象限 Q 中的段 [ya, yb]，返回 ptr 之后的位置。查找瞳孔的纯色段时，
+// 瞳孔记录为一个段，只渲染它前后的像素。
+template<int F, int Q>
+static uint16_t *renderQuadrant(const eyeTables *tables, const shadeState *s,
+  const columnHalf *c, int ya, int yb, uint16_t *ptr) {
+  int pa, pb;
+  if(s->pupilRuns && (tables->octant ? findPupilT<Q, true >(tables, s, c, ya, yb, &pa, &pb) :
+                                       findPupilT<Q, false>(tables, s, c, ya, yb, &pa, &pb))) {
+    if(pa > ya) renderSpan<F, Q>(tables, s, c, ya, pa - 1, ptr);
+    ptr = fillRun(s->runs, RUN_PUPIL, s->pupilColor, pa, pb - pa + 1, ptr + (pa - ya));
+    if(pb < yb) renderSpan<F, Q>(tables, s, c, pb + 1, yb, ptr);
+    return ptr + (yb - pb);
+  }
+  renderSpan<F, Q>(tables, s, c, ya, yb, ptr);
+  return ptr + (yb - ya + 1);
+}
+
+// 渲染半列中位于眼球内的部分 [ya, yb]
+template<int F>
+static uint16_t *renderHalf(const eyeTables *tables, const shadeState *s,
+  const columnHalf *c, int ya, int yb, uint16_t *ptr) {
+  if(ya > yb) return ptr;
+
+  // 收集地图边界穿越点（每个坐标 3 个阈值），排序
+  const int R = tables->mapRadius, D = tables->mapDiameter;
+  int       splits[7], n = 0, i, j;
+  splits[n++] = findSplit(c, false, 0, ya, yb);
+  splits[n++] = findSplit(c, false, R, ya, yb);
+  splits[n++] = findSplit(c, false, D, ya, yb);
+  splits[n++] = findSplit(c, true , 0, ya, yb);
+  splits[n++] = findSplit(c, true , R, ya, yb);
+  splits[n++] = findSplit(c, true , D, ya, yb);
+  splits[n++] = yb + 1;
+  for(i=1; i<n; i++) { // 插入排序，最多 7 个元素
+    int v = splits[i];
+    for(j=i; (j > 0) && (splits[j-1] > v); j--) splits[j] = splits[j-1];
+    splits[j] = v;
+  }
+
+  // 每段的分类在段的第一个像素处确定
+  int sa = ya;
+  for(i=0; i<n; i++) {
+    int sb = splits[i] - 1;
+    if(sb < sa) continue; // 空段（重复的穿越点）
+    int mx = mapX(c, sa), my = mapY(c, sa);
+    if((mx < 0) || (mx >= D) || (my < 0) || (my >= D)) {
+      // 超出地图，使用眼睛背面颜色
+      ptr = fillRun(s->runs, RUN_BACK, s->backColor, sa, sb - sa + 1, ptr);
+    } else if(my >= R) {
+      if(mx >= R) ptr = renderQuadrant<F, 1>(tables, s, c, sa, sb, ptr);
+      else        ptr = renderQuadrant<F, 2>(tables, s, c, sa, sb, ptr);
+    } else {
+      if(mx <  R) ptr = renderQuadrant<F, 3>(tables, s, c, sa, sb, ptr);
+      else        ptr = renderQuadrant<F, 4>(tables, s, c, sa, sb, ptr);
+    }
+    sa = sb + 1;
+  }
+  return ptr;
+}
+
+// 将列 'x' 中从 y1 到 y2（含）的像素渲染到 buf 中，
+// 共 (y2 - y1 + 1) 个像素。眼睑区域（y1 以下和 y2 以上）由调用者处理。
+// state->runs 非 NULL 时，纯色段记录在那里，buf 中的这些像素不写入。
+template<int F>
+static void renderColumnT(const eyeTables *tables, const eyeRenderState *state,
+  int x, int y1, int y2, uint16_t *buf) {
+  const int  half = tables->displaySize / 2;
+  uint16_t  *ptr  = buf;
+  columnHalf c;
+  shadeState s;
+  int        y;
+
+  s.irisData     = state->iris->data;
+  s.irisIndex    = state->iris->index;
+  s.irisRow      = state->iris->rowOffset;
+  s.irisCol      = state->iris->colOffset;
+  s.irisWidth    = state->iris->width;
+  s.irisHeight   = state->iris->height;
+  s.irisAngle    = state->iris->angle;
+  s.irisMirror   = state->iris->mirror;
+  s.irisColor    = state->iris->data[0];   // 纯色纹理的 data 指向 color
+  s.scleraData   = state->sclera->data;
+  s.scleraIndex  = state->sclera->index;
+  s.scleraRow    = state->sclera->rowOffset;
+  s.scleraCol    = state->sclera->colOffset;
+  s.scleraWidth  = state->sclera->width;
+  s.scleraHeight = state->sclera->height;
+  s.scleraAngle  = state->sclera->angle;
+  s.scleraMirror = state->sclera->mirror;
+  s.scleraColor  = state->sclera->data[0];
+  s.irisBits     = state->iris->widthBits;
+  s.irisShift    = 10 - s.irisBits;
+  s.scleraBits   = state->sclera->widthBits;
+  s.scleraShift  = 10 - s.scleraBits;
+  s.iPupilFactor = state->iPupilFactor;
+  // 以前每个虹膜像素计算 ty = dist * iPupilFactor / -32768 并与纹理高度比较。
+  // ty >= irisHeight 等价于 -dist * iPupilFactor >= irisHeight * 32768，
+  // 所以每列做一次向上取整的除法，得到瞳孔边缘的距离。
+  s.pupilDist    = (state->iPupilFactor > 0) ?
+    (int)(((uint32_t)s.irisHeight * 32768 + state->iPupilFactor - 1) /
+    (uint32_t)state->iPupilFactor) : 128;
+  s.pupilColor   = state->pupilColor;
+  s.backColor    = state->backColor;
+  s.runs         = state->runs;
+  s.pupilRuns    = state->pupilRuns && s.runs && (s.pupilDist < 128) && ((s.pupilColor >> 8) == (s.pupilColor & 0xFF));
+  if(s.runs) s.runs->count = 0;
+
+  // tablegen.cpp 解释了一些位移映射技巧。
+  if(x < half) { // 屏幕的左半部分（象限 2, 3）
+    c.displaceX = &tables->displace[ (half - 1) - x        ];
+    c.displaceY = &tables->displace[((half - 1) - x) * half];
+    c.xmul      = -1; // X 位移始终为负
+  } else {       // 屏幕的右半部分（象限 1, 4）
+    c.displaceX = &tables->displace[ x - half        ];
+    c.displaceY = &tables->displace[(x - half) * half];
+    c.xmul      =  1; // X 位移始终为正
+  }
+  c.half      = half;
+  c.xx        = state->xPosition + x;
+  c.yPosition = state->yPosition;
+
+  // 此列中眼球的半高：displaceX 在眼球外为 255，并且从列的中心
+  // 向外看，眼球内的像素是一个连续的前缀，所以可以二分查找。
+  int lo = 0, hi = half; // 不变量：[0, lo) 在眼球内，[hi, half) 在眼球外
+  while(lo < hi) {
+    int mid = (lo + hi) / 2;
+    if(c.displaceX[mid * half] < 255) lo = mid + 1;
+    else                              hi = mid;
+  }
+  int eyeBottom = half - lo, eyeTop = half - 1 + lo; // 眼球内的 y 范围
+
+  // 眼球下方（超出眼球区域）
+  ptr = fillRun(s.runs, RUN_EYELID, state->eyelidColor, y1, ((y2 < eyeBottom) ? y2 + 1 : eyeBottom) - y1, ptr);
+
+  // 屏幕的下半部分（象限 3, 4），doff = (half - 1) - y
+  c.dstep = -1;
+  c.dbase = half - 1;
+  ptr = renderHalf<F>(tables, &s, &c, (y1 > eyeBottom) ? y1 : eyeBottom,
+    (y2 < (half - 1)) ? y2 : (half - 1), ptr);
+
+  // 屏幕的上半部分（象限 1, 2），doff = y - half
+  c.dstep = 1;
+  c.dbase = -half;
+  ptr = renderHalf<F>(tables, &s, &c, (y1 > half) ? y1 : half,
+    (y2 < eyeTop) ? y2 : eyeTop, ptr);
+
+  // 眼球上方
+  y = (y1 > eyeTop) ? y1 : (eyeTop + 1);
+  fillRun(s.runs, RUN_EYELID, state->eyelidColor, y, y2 - y + 1, ptr);
+}
+
+// 每种特性组合的一个内核实例。没有纹理时其他特性都不起作用，这些组合
+// 共用一个实例；块布局的内核不使用 RENDER_POW2（逐行存储的纹理用乘法），
+// 以免生成大量相同或用不到的内核。
+#define KERNEL(f) renderColumnT<!((f) & (RENDER_IRIS_TEXTURE | RENDER_SCLERA_TEXTURE)) ? 0 : \
+  ((f) & RENDER_TILED) ? ((f) & ~RENDER_POW2) : (f)>
+#define KERNELS8(f) KERNEL(f  ), KERNEL(f+1), KERNEL(f+2), KERNEL(f+3), \
+                    KERNEL(f+4), KERNEL(f+5), KERNEL(f+6), KERNEL(f+7)
+static const columnRenderer renderers[64] = {
+  KERNELS8( 0), KERNELS8( 8), KERNELS8(16), KERNELS8(24),
+  KERNELS8(32), KERNELS8(40), KERNELS8(48), KERNELS8(56) };
+
+// 块布局中像素 (x, y) 的位置（像素，从纹理开始计算）。见 render.h。
+uint32_t tiledOffset(int width, int tileHeight, int x, int y) {
+  uint32_t w = (width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH; // 填充后的宽度
+  return (uint32_t)(y / tileHeight) * w * tileHeight +
+    (x / TILE_WIDTH) * (TILE_WIDTH * tileHeight) +
+    (y % tileHeight) * TILE_WIDTH + (x % TILE_WIDTH);
+}
+
+// 纹理像素（或索引）占用的字节数，包括块布局的填充
+uint32_t textureBytes(const texture *tex) {
+  uint32_t bpp = tex->index ? 1 : 2;
+  if(!tex->tileHeight) return (uint32_t)tex->width * tex->height * bpp;
+  return (uint32_t)(tex->width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH *
+    ((tex->height + tex->tileHeight - 1) / tex->tileHeight * tex->tileHeight) * bpp;
+}
+
+// 为 tileHeight 非零的纹理分配并填充地址表。地址在两个方向上可分离，
+// 所以 rowOffset[y] + colOffset[角度] = tiledOffset(x, y)，其中
+// x = 角度 * 宽度 / 1024（与逐行存储时的纹理 x 相同）。RAM 不足时返回
+// false，tileHeight 设为 0。
+bool prepareTiles(texture *tex) {
+  if(!tex->tileHeight) return false;
+  if((uint32_t)(tex->width + TILE_WIDTH) * tex->tileHeight <= 65535) {
+    tex->rowOffset = (uint32_t *)heapAlloc(HEAP_TEXTURES, tex->height * sizeof(uint32_t));
+    tex->colOffset = (uint16_t *)heapAlloc(HEAP_TEXTURES, 1024 * sizeof(uint16_t));
+  }
+  if(!tex->rowOffset || !tex->colOffset) {
+    heapFree(tex->rowOffset);
+    heapFree(tex->colOffset);
+    tex->rowOffset  = NULL;
+    tex->colOffset  = NULL;
+    tex->tileHeight = 0;
+    return false;
+  }
+  for(int y=0; y<tex->height; y++) {
+    tex->rowOffset[y] = tiledOffset(tex->width, tex->tileHeight, 0, y);
+  }
+  for(int a=0; a<1024; a++) {
+    tex->colOffset[a] = tiledOffset(tex->width, tex->tileHeight,
+      (a * tex->width) >> 10, 0);
+  }
+  return true;
+}
+
+// 在纹理加载（或改变）之后计算纹理的寻址字段。
+void prepareTexture(texture *tex) {
+  tex->widthBits = -1;
+  for(int b=0; b<=10; b++) { // 宽度最大 1024 时才能用角度移位
+    if(tex->width == (1 << b)) {
+      tex->widthBits = b;
+      break;
+    }
+  }
+}
+
+// 返回与这对纹理匹配的内核。在纹理加载并调用 prepareTexture() 之后调用一次
+// （纹理是否为纯色、是否镜像、宽度在运行期间不会改变；旋转角度可以改变，
+// 每列都会重新读取）。
+columnRenderer selectRenderer(const texture *iris, const texture *sclera) {
+  int flags = 0;
+  if(iris->data   != &iris->color)            flags |= RENDER_IRIS_TEXTURE;
+  if(sclera->data != &sclera->color)          flags |= RENDER_SCLERA_TEXTURE;
+  if(iris->mirror || sclera->mirror)          flags |= RENDER_MIRROR;
+  // 仅当每个有纹理的图像宽度都是 2 的幂时才使用移位寻址
+  if(((iris->widthBits   >= 0) || !(flags & RENDER_IRIS_TEXTURE)) &&
+     ((sclera->widthBits >= 0) || !(flags & RENDER_SCLERA_TEXTURE)) &&
+     (flags & (RENDER_IRIS_TEXTURE | RENDER_SCLERA_TEXTURE))) {
+    flags |= RENDER_POW2;
+  }
+  if(((flags & RENDER_IRIS_TEXTURE)   && iris->index) ||
+     ((flags & RENDER_SCLERA_TEXTURE) && sclera->index)) {
+    flags |= RENDER_INDEXED;
+  }
+  if(((flags & RENDER_IRIS_TEXTURE)   && iris->rowOffset) ||
+     ((flags & RENDER_SCLERA_TEXTURE) && sclera->rowOffset)) {
+    flags |= RENDER_TILED;
+  }
+  return renderers[flags];
+}
+
+// 通用内核，适用于任何纹理组合
+void renderColumn(const eyeTables *tables, const eyeRenderState *state,
+  int x, int y1, int y2, uint16_t *buf) {
+  renderColumnT<RENDER_IRIS_TEXTURE | RENDER_SCLERA_TEXTURE | RENDER_MIRROR |
+    RENDER_INDEXED | RENDER_TILED>(
+    tables, state, x, y1, y2, buf);
+}
@@ -0,0 +1,149 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 列渲染器（render.cpp）和表生成器（tablegen.cpp）使用的类型和函数。
+// 此头文件不依赖 Arcada、DMA 或任何开发板专用的库，因此这两个文件
+// 既可以为 SAMD51 编译，也可以不加修改地在 Linux 主机上编译
+// （参见 tools/eyebench，用于在工作站上测量渲染性能）。
+
+#ifndef __RENDER_H
+#define __RENDER_H
+
+#if defined(ARDUINO)
+  #include <Arduino.h>
+#else
+  #include <stdint.h>
+  #include <stdlib.h>
+  #include <math.h>
+  static inline void yield(void) { } // 主机上没有需要保持活动的大容量存储
+#endif
+
+// 虹膜和巩膜纹理地图的数据
+typedef struct {
+  char     *filename;
+  float     spin;       // RPM * 1024.0
+  uint16_t  color;
+  uint16_t *data;
+  uint16_t  width;
+  uint16_t  height;
+  uint16_t  startAngle; // 初始旋转 0-1023 逆时针
+  uint16_t  angle;      // 当前旋转 0-1023 逆时针
+  uint16_t  mirror;     // 0 = 正常，1023 = 翻转 X 轴
+  uint16_t  iSpin;      // 每帧固定整数旋转，覆盖 'spin' 值
+  int8_t    widthBits;  // log2(width)，宽度不是 2 的幂（或 > 1024）时为 -1
+  uint8_t  *index;      // 8 位索引纹理：每像素一个调色板索引，data 指向
+                        // 256 色调色板（RAM 中，可以在运行时改写）；NULL = data 是像素
+  uint8_t   tileHeight; // 0 = 像素逐行存储；否则按块存储（见下文）
+  uint32_t *rowOffset;  // 块布局的地址表（prepareTiles() 生成）：
+  uint16_t *colOffset;  // 像素 (x, y) 在 rowOffset[y] + colOffset[角度] 处
+  uint8_t   priority;   // 越高越先放入更快的存储器（见 memory.cpp）
+  uint8_t   tier;       // 像素（或索引）当前所在的存储器，TIER_*（见 globals.h）
+} texture;
+
+// 块布局：渲染器沿屏幕的列行进时，纹理采样点大多沿纹理的 Y 方向（半径）
+// 移动，在逐行存储的纹理中每一步都跨过一整行，几乎每次读取都是一个新的
+// CMCC 缓存行。块布局把纹理分成 TILE_WIDTH x tileHeight 像素的块，每块正好
+// 是一个 16 字节的缓存行（tileHeight 为 16 位像素 4 行，8 位索引 8 行），
+// 块在闪存中逐行排列，块内的像素也逐行排列。宽度填充到 TILE_WIDTH 的倍数，
+// 高度填充到 tileHeight 的倍数（重复最后一列或一行）。
+// 用 tools/texcache 比较某个预设使用两种布局时的缓存未命中次数。
+#define TILE_WIDTH 2
+#define TILE_BYTES 16 // 一个 CMCC 缓存行
+
+// 极坐标地图的一个条目。角度和距离交错存储，渲染器每个像素只需一次读取。
+typedef struct {
+  uint8_t angle; // 0 到 <256，顺时针，0 在顶部（第一象限）
+  int8_t  dist;  // 0 到 127 = 巩膜，-1 到 -127 = 虹膜，-128 = 超出眼睛
+} polarEntry;
+
+// calcMap() 或 calcDisplacement() 生成的表内容或布局改变时递增，
+// 使保存在文件系统上的表缓存失效（见 file.cpp 中的 loadTables()）。
+#define TABLE_FORMAT 1
+
+// 一组预计算的表（参见 tablegen.cpp）以及生成它们所用的几何参数。
+// 几何字段在调用 calcMap() 和 calcDisplacement() 之前设置。
+typedef struct {
+  int               displaySize;     // 屏幕宽度和高度（像素）
+  int               eyeRadius;       // 眼球半径（屏幕像素）
+  int               irisRadius;      // 虹膜半径（屏幕像素）
+  int               slitPupilRadius; // 0 = 圆形瞳孔
+  int               mapRadius;       // 极坐标地图一个象限的大小（像素）
+  int               mapDiameter;     // mapRadius * 2
+  const uint8_t    *displace;        // 位移映射，屏幕的四分之一
+  const polarEntry *polar;           // 极坐标地图，一个象限或八分圆（见 calcMap()）
+  bool              octant;          // true = polar 只存储对角线以下的八分圆
+} eyeTables;
+
+// 纯色段：列中一段颜色相同的像素，渲染器不写入 buf，由调用者用一个
+// 不递增的 DMA 描述符从颜色的一个字节发出（HalloWing，见 M4_Eyes.ino）。
+// SPI DMA 按字节重复源地址，所以只有两个字节相同的颜色（例如黑色
+// 0x0000、白色 0xFFFF，以及 eyelidIndex 扩展成的眼睑颜色）可以这样发出，
+// 其他颜色照常写入 buf。
+#define RUN_MIN    8 // 短于此的段照常写入 buf（不值得一个描述符）
+#define MAX_RUNS   6 // 一列中记录的段数的上限，更多的照常写入 buf
+#define RUN_EYELID 0 // 眼球外（eyelidColor）
+#define RUN_BACK   1 // 超出地图的眼睛背面（backColor）
+#define RUN_PUPIL  2 // 瞳孔（pupilColor）
+
+typedef struct {
+  uint8_t y;     // 第一个像素（列中的 y）
+  uint8_t count; // 像素数
+  uint8_t kind;  // RUN_*
+} colorRun;
+
+typedef struct {
+  uint8_t  count;         // 记录的段数
+  colorRun run[MAX_RUNS]; // 按 y 排序，不重叠
+} colorRuns;
+
+// 渲染一列所需的每只眼睛状态的快照。在 loop() 中每列填充一次，
+// 使渲染器不必直接访问 eye[] 或其他全局变量。
+typedef struct {
+  int            xPosition;    // 屏幕左下角在极坐标地图上的位置
+  int            yPosition;
+  int            iPupilFactor; // 虹膜纹理 Y 缩放（随瞳孔大小变化，每帧计算）
+  uint16_t       pupilColor;   // 16 位 565 RGB，大端格式
+  uint16_t       backColor;    // 同上
+  uint16_t       eyelidColor;  // 同上
+  const texture *iris;         // 虹膜纹理地图
+  const texture *sclera;       // 巩膜纹理地图
+  colorRuns     *runs;         // NULL = 所有像素写入 buf；否则纯色段（见上面）记录在
+                               // 这里，buf 中对应的像素不写入（其余像素位置不变）
+  bool           pupilRuns;    // runs 不为 NULL 时也查找瞳孔的纯色段（见 render.cpp
+                               // 中的 findPupilT()，查找本身有开销）
+} eyeRenderState;
+
+// 列渲染函数的类型。render.cpp 为每种特性组合（见下面的 RENDER_*）
+// 生成一个专用版本，selectRenderer() 在配置和纹理加载后为每只眼睛选择一个。
+typedef void (*columnRenderer)(const eyeTables *tables,
+  const eyeRenderState *state, int x, int y1, int y2, uint16_t *buf);
+
+#define RENDER_IRIS_TEXTURE   1 // 虹膜有纹理图像（否则为纯色）
+#define RENDER_SCLERA_TEXTURE 2 // 巩膜有纹理图像（否则为纯色）
+#define RENDER_MIRROR         4 // 虹膜或巩膜沿 X 轴翻转
+#define RENDER_POW2           8 // 所有纹理宽度都是 2 的幂，用移位代替乘法
+#define RENDER_INDEXED       16 // 至少一个纹理是 8 位索引（见 texture.index）
+#define RENDER_TILED         32 // 至少一个纹理使用块布局（见 texture.tileHeight）
+
+// render.cpp 中的函数
+extern void           renderColumn(const eyeTables *tables,
+                        const eyeRenderState *state, int x, int y1, int y2,
+                        uint16_t *buf);
+extern void           prepareTexture(texture *tex);
+extern bool           prepareTiles(texture *tex);
+extern uint32_t       textureBytes(const texture *tex);
+extern uint32_t       tiledOffset(int width, int tileHeight, int x, int y);
+extern columnRenderer selectRenderer(const texture *iris, const texture *sclera);
+
+// tablegen.cpp 中的函数
+extern void  calcDisplacement(eyeTables *tables);
+extern void  calcMap(eyeTables *tables);
+extern int   polarMapSize(const eyeTables *tables, bool octant);
+extern int   tableSetSize(const eyeTables *tables);
+extern float screen2map(const eyeTables *tables, int in);
+extern float map2screen(const eyeTables *tables, int in);
+
+#endif // __RENDER_H
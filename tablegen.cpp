@@ -4,7 +4,8 @@
 
 //34567890123456789012345678901234567890123456789012345678901234567890123456
 
-#include "globals.h"
+#include "render.h"
+#include "heapstat.h"
 
 // 此文件中的代码计算用于眼睛渲染的各种表格。
 
@@ -12,12 +13,17 @@
 // 所以使用 2D 位移映射来伪造圆形眼球形状，类似于 Photoshop 的位移滤镜或老式的演示场景和屏幕保护程序技巧。
 // 这并不是真正的 3D 旋转的准确表示，但足以欺骗普通观察者。
 
-void calcDisplacement() {
+void calcDisplacement(eyeTables *tables) {
+  const int DISPLAY_SIZE = tables->displaySize;
+  const int eyeRadius    = tables->eyeRadius;
+  const int mapRadius    = tables->mapRadius;
   // 为了节省 RAM，位移映射仅为屏幕的四分之一计算，
   // 然后在渲染时沿中间水平/垂直镜像。
   // 此外，只需要计算一个轴的位移，因为眼睛形状在 X/Y 对称，
   // 只需交换轴即可查找相对轴的位移。
-  if(displace = (uint8_t *)malloc((DISPLAY_SIZE/2) * (DISPLAY_SIZE/2))) {
+  uint8_t *displace;
+  if(displace = (uint8_t *)heapAlloc(HEAP_TABLES, (DISPLAY_SIZE/2) * (DISPLAY_SIZE/2))) {
+    tables->displace = displace;
     float    eyeRadius2 = (float)(eyeRadius * eyeRadius); // 眼睛半径的平方
     uint8_t  x, y;
     float    dx, dy, d2, d, h, a, pa;
@@ -50,57 +56,104 @@ void calcDisplacement() {
 }
 
 
-void calcMap(void) {
-  int pixels = mapRadius * mapRadius;
-  if(polarAngle = (uint8_t *)malloc(pixels * 2)) { // 为两个表分配单个内存块
-    polarDist = (int8_t *)&polarAngle[pixels];     // 偏移到第二个表
+// 极坐标地图的字节数，按八分圆或整个象限存储
+int polarMapSize(const eyeTables *tables, bool octant) {
+  const int mapRadius = tables->mapRadius;
+  return (octant ? (mapRadius * (mapRadius + 1) / 2) : (mapRadius * mapRadius)) *
+    sizeof(polarEntry);
+}
+
+// calcMap() 和 calcDisplacement() 为此几何分配的总字节数
+int tableSetSize(const eyeTables *tables) {
+  return polarMapSize(tables, tables->slitPupilRadius <= 0) +
+    (tables->displaySize / 2) * (tables->displaySize / 2);
+}
+
+void calcMap(eyeTables *tables) {
+  const int mapRadius       = tables->mapRadius;
+  const int slitPupilRadius = tables->slitPupilRadius;
+  // 圆形瞳孔的地图关于对角线对称：(x, y) 处的距离与 (y, x) 处相同，
+  // 角度为 255 - 角度。因此只存储 y <= x 的八分圆，按列存储为
+  // [x * (x + 1) / 2 + y]，渲染器在查找时镜像（参见 render.cpp），
+  // 表的大小减半。狭缝瞳孔不对称，仍存储整个象限 [x * mapRadius + y]。
+  const bool  octant          = (slitPupilRadius <= 0);
+  polarEntry *polar;
+  if(polar = (polarEntry *)heapAlloc(HEAP_TABLES, polarMapSize(tables, octant))) {
+    tables->polar  = polar;
+    tables->octant = octant;
 
     // 计算极角和距离
 
     float mapRadius2  = mapRadius * mapRadius;  // 半径平方
-    float iRad        = screen2map(irisRadius); // 虹膜大小在极坐标映射像素中
+    float iRad        = screen2map(tables, tables->irisRadius); // 虹膜大小在极坐标映射像素中
     float irisRadius2 = iRad * iRad;            // 虹膜大小平方
 
-    uint8_t *anglePtr = polarAngle;
-    int8_t  *distPtr  = polarDist;
+    polarEntry *ptr = polar;
 
     // 与位移映射类似，仅计算第一象限，
-    // 其他三个象限从此镜像/旋转。
+    // 其他三个象限从此镜像（参见 render.cpp）。
+    // 地图按列存储（X 在外循环），因为渲染器逐列绘制屏幕，
+    // 这样沿一列读取的是相邻的条目（八分圆中，对角线另一侧镜像过来的
+    // 部分除外）。
     int   x, y;
-    float dx, dy, dy2, d2, d, angle, xp;
-    for(y=0; y<mapRadius; y++) {
+    float dx, dy, dx2, dy2, d2, d, angle, xp;
+    for(x=0; x<mapRadius; x++) {
       yield(); // 定期 yield() 确保大容量存储文件系统保持活动状态
-      dy  = (float)y + 0.5;        // Y 到地图中心的距离
-      dy2 = dy * dy;
-      for(x=0; x<mapRadius; x++) {
-        dx = (float)x + 0.5;       // X 到地图中心的距离
-        d2 = dx * dx + dy2;        // 到地图中心的距离，平方
+      dx  = (float)x + 0.5;        // X 到地图中心的距离
+      dx2 = dx * dx;
+      int yMax = octant ? x : (mapRadius - 1);
+      for(y=0; y<=yMax; y++, ptr++) {
+        dy = (float)y + 0.5;       // Y 到地图中心的距离
+        d2 = dx2 + dy * dy;        // 到地图中心的距离，平方
         if(d2 > mapRadius2) {      // 如果超过地图大小的一半，平方，
-          *anglePtr++ = 0;         // 则标记为超出眼睛范围
-          *distPtr++  = -128;
+          ptr->angle = 0;          // 则标记为超出眼睛范围
+          ptr->dist  = -128;
         } else {                   // 否则像素在眼睛区域内...
           angle  = atan2(dy, dx);  // -pi 到 +pi（第一象限中 0 到 +pi/2）
           angle  = M_PI_2 - angle; // 顺时针，0 在顶部
           angle *= 512.0 / M_PI;   // 第一象限中 0 到 <256
-          *anglePtr++ = (uint8_t)angle;
+          ptr->angle = (uint8_t)angle;
           d = sqrt(d2);
           if(d2 > irisRadius2) {
             // 点在巩膜中
             d = (mapRadius - d) / (mapRadius - iRad);
             d *= 127.0;
-            *distPtr++ = (int8_t)d; // 0 到 127
+            ptr->dist = (int8_t)d; // 0 到 127
           } else {
             // 点在虹膜中（-dist 表示如此）
             d = (iRad - d) / iRad;
             d *= -127.0;
-            *distPtr++ = (int8_t)d - 1; // -1 到 -127
+            ptr->dist = (int8_t)d - 1; // -1 到 -127
           }
         }
       }
     }
 
-    // 如果启用了狭缝瞳孔，覆盖 polarDist 映射的虹膜区域。
+    // 如果启用了狭缝瞳孔，覆盖极坐标地图虹膜区域中的距离
+    // （此时地图按整个象限存储，见上文）。
     if(slitPupilRadius > 0) {
+      // 狭缝瞳孔由一系列圆 i = 0 到 126 表示，每个圆的中心在 Y 为 0.0 处，
+      // 穿过两个点：一个点在虹膜顶部和狭缝瞳孔顶部之间，另一个点在虹膜
+      // 右侧和眼睛中心之间，都按比例 i / 128 插值。圆 0 就是整个虹膜，
+      // 随着 i 增大，圆收缩到狭缝，每个圆都在前一个圆之内。虹膜中的每个
+      // 像素取包含它的最大的 i 作为距离。
+      // 以前每个像素从 126 开始逐个尝试每个圆（最多 127 次圆拟合）。
+      // 圆只取决于 i，所以这里先计算一次；而“像素在圆 i 内”随 i 单调，
+      // 所以每个像素用二分查找（最多 7 次测试）得到同样的结果。
+      float xc[127], r2[127];
+      for(int i=0; i<127; i++) {
+        float ratio = i / 128.0; // 0.0（打开）到接近 1.0（狭缝）（>= 1.0 会导致问题）
+        // 根据比例在虹膜顶部和狭缝瞳孔顶部之间插值一个点
+        float y1 = iRad - (iRad - slitPupilRadius) * ratio;
+        // (x1 为 0，因此从下面的方程中删除)
+        // 另一个点在虹膜右侧和眼睛中心之间，反比例
+        float x2 = iRad * (1.0 - ratio);
+        // (y2 也为零，同样处理)
+        // 找到穿过上述两个点并在 Y 为 0.0 处的圆的中心 X 坐标
+        xc[i] = (x2 * x2 - y1 * y1) / (2 * x2);
+        dx    = x2 - xc[i];      // 从圆心到右边缘的距离
+        r2[i] = dx * dx;         // 圆心到右边缘的距离平方
+      }
       // 遍历极坐标映射的虹膜部分的每个像素...
       for(y=0; y < mapRadius; y++) {
         yield(); // 定期 yield() 确保大容量存储文件系统保持活动状态
@@ -110,31 +163,17 @@ void calcMap(void) {
           dx = x + 0.5;           // 到中心点的距离，X 分量
           d2 = dx * dx + dy2;     // 到中心的距离，平方
           if(d2 <= irisRadius2) { // 如果在虹膜内...
-            yield();
             xp = x + 0.5;
-            // 这有点丑陋，因为它迭代计算 polarDist 值...试错法。
-            // 应该可以代数简化并找到给定像素的单个 polarDist 点，
-            // 但我还没有解决这个问题。
-            // 这仅在启动时需要一次，不是完全灾难。
-            for(int i=126; i>=0; i--) {
-              float ratio = i / 128.0; // 0.0（打开）到接近 1.0（狭缝）（>= 1.0 会导致问题）
-              // 根据比例在虹膜顶部和狭缝瞳孔顶部之间插值一个点
-              float y1 = iRad - (iRad - slitPupilRadius) * ratio;
-              // (x1 为 0，因此从下面的方程中删除)
-              // 另一个点在虹膜右侧和眼睛中心之间，反比例
-              float x2 = iRad * (1.0 - ratio);
-              // (y2 也为零，同样处理)
-              // 找到穿过上述两个点并在 Y 为 0.0 处的圆的中心 X 坐标
-              float xc = (x2 * x2 - y1 * y1) / (2 * x2);
-              dx = x2 - xc;       // 从圆心到右边缘的距离
-              float r2 = dx * dx; // 圆心到右边缘的距离平方
-              dx = xp - xc;       // ...的 X 分量
-              d2 = dx * dx + dy2; // 像素到左侧 'xc' 点的距离
-              if(d2 <= r2) {      // 如果点在圆内...
-                polarDist[y * mapRadius + x] = (int8_t)(-1 - i); // 设置为距离 'i'
-                break;
-              }
+            dx = xp - xc[0];
+            if((dx * dx + dy2) > r2[0]) continue; // 不在任何圆内
+            int lo = 0, hi = 127; // 不变量：点在圆 lo 内，不在圆 hi 内（或 hi 超出范围）
+            while((hi - lo) > 1) {
+              int mid = (lo + hi) / 2;
+              dx = xp - xc[mid];  // 像素到 'xc' 点的 X 分量
+              if((dx * dx + dy2) <= r2[mid]) lo = mid;
+              else                           hi = mid;
             }
+            polar[x * mapRadius + y].dist = (int8_t)(-1 - lo); // 设置为距离 'i'
           }
         }
       }
@@ -143,11 +182,12 @@ void calcMap(void) {
 }
 
 // 将屏幕像素中的测量值缩放到极坐标映射像素
-float screen2map(int in) {
-  return atan2(in, sqrt(eyeRadius * eyeRadius - in * in)) / M_PI_2 * mapRadius;
+float screen2map(const eyeTables *tables, int in) {
+  return atan2(in, sqrt(tables->eyeRadius * tables->eyeRadius - in * in)) /
+    M_PI_2 * tables->mapRadius;
 }
 
 // 上述的反函数
-float map2screen(int in) {
-  return sin((float)in / (float)mapRadius) * M_PI_2 * eyeRadius;
+float map2screen(const eyeTables *tables, int in) {
+  return sin((float)in / (float)tables->mapRadius) * M_PI_2 * tables->eyeRadius;
 }
@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// .tex 纹理文件格式。BMP 文件需要逐像素转换格式和字节序（从下到上存储的
+// 文件还要逐行 seek）；.tex 文件的像素已经是屏幕字节序（大端）的 RGB565，
+// 所以固件可以按顺序把它直接复制到闪存（见 file.cpp 中的 loadTexture()）。
+// 用 tools/bmp2tex 从 BMP 转换。
+//
+// 文件布局：一个 texHeader（所有多字节字段为小端），然后是
+// width * height 个像素，从上到下逐行，每个像素 2 字节，高字节在前。
+// 索引格式（TEX_FORMAT_INDEXED8）在像素之前有一个 256 色的调色板，
+// 每个像素是 1 字节的调色板索引。
+// 此头文件不依赖任何开发板专用的库，主机工具也使用它。
+
+#ifndef __TEXFILE_H
+#define __TEXFILE_H
+
+#include <stdint.h>
+
+#define TEX_MAGIC           0x31584554 // 文件以 "TEX1" 开头（按小端读取）
+#define TEX_FORMAT_RGB565   0          // 大端 RGB565，每像素 2 字节
+#define TEX_FORMAT_INDEXED8 1          // 256 色调色板（大端 RGB565，512 字节），
+                                       // 然后每像素 1 字节的调色板索引
+
+typedef struct {
+  uint32_t magic;       // TEX_MAGIC
+  uint16_t width;       // 像素
+  uint16_t height;
+  uint8_t  format;      // TEX_FORMAT_*
+  uint8_t  reserved[7]; // 0
+} texHeader;            // 16 字节
+
+#endif // __TEXFILE_H
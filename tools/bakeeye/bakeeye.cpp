@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 为固定的预设生成 fixedtables.h。对于永久使用一个预设的设备，
+// 固件可以不在启动时计算位移和极坐标表（放在堆 RAM 中），而是编译进
+// 这里生成的 const 数组（放在闪存中）：启动时没有表生成时间，
+// 原本用于表的 SRAM 可以留给纹理或音频缓冲区。
+// 表由与固件完全相同的 tablegen.cpp 生成，与主机上运行 calcMap() 和
+// calcDisplacement() 的结果逐字节相同。开发板上的 newlib sqrt()/atan2()
+// 与主机的 C 库舍入可能不同，所以个别条目可能与开发板启动时生成的表
+// 不同（没有在开发板上比较过）。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o bakeeye bakeeye.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./bakeeye [-s displaysize] [-e left|right] ../../eyes/hazel > ../../fixedtables.h
+// 然后在 globals.h 中取消 FIXED_TABLES 的注释并重新编译固件。
+// 如果 SD/闪存上的配置文件与生成时的几何参数不同，固件会打印一条消息，
+// 退回到运行时生成表。
+
+#include <unistd.h>
+#include "../common/hosteye.h"
+#include "../../render.h"
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-s displaysize] [-e left|right] "
+    "preset_dir|config.eye > fixedtables.h\n", prog);
+  exit(1);
+}
+
+// 以 C 数组初始化器的格式输出字节，每行 16 个
+static void printBytes(const uint8_t *data, int n) {
+  for(int i=0; i<n; i++) {
+    printf("%s0x%02X,%s", (i & 15) ? " " : "  ", data[i],
+      ((i & 15) == 15) || (i == n - 1) ? "\n" : "");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int         displaySize = 240;
+  const char *eyeName     = NULL;
+  int         opt;
+
+  while((opt = getopt(argc, argv, "s:e:")) != -1) {
+    switch(opt) {
+     case 's': displaySize = atoi(optarg); break;
+     case 'e': eyeName     = optarg;       break;
+     default : usage(argv[0]);
+    }
+  }
+  if((optind >= argc) || (displaySize < 2) || (displaySize > 240)) usage(argv[0]);
+
+  presetConfig cfg;
+  if(!loadPreset(argv[optind], displaySize, eyeName, &cfg)) return 1;
+
+  eyeTables tables = { 0 };
+  tables.displaySize     = displaySize;
+  tables.eyeRadius       = cfg.eyeRadius;
+  tables.irisRadius      = cfg.irisRadius;
+  tables.slitPupilRadius = cfg.slitPupilRadius;
+  tables.mapRadius       = cfg.mapRadius;
+  tables.mapDiameter     = cfg.mapRadius * 2;
+  calcMap(&tables);
+  calcDisplacement(&tables);
+  if(!tables.polar || !tables.displace) {
+    fprintf(stderr, "Table allocation failed\n");
+    return 1;
+  }
+
+  int polarBytes    = polarMapSize(&tables, tables.octant);
+  int displaceBytes = (displaySize / 2) * (displaySize / 2);
+
+  printf("// 由 tools/bakeeye 从 %s%s%s 生成，不要手动编辑。\n",
+    argv[optind], eyeName ? " eye " : "", eyeName ? eyeName : "");
+  printf("// 仅由 M4_Eyes.ino 包含（在 globals.h 中定义 FIXED_TABLES 时）。\n\n");
+  printf("#define FIXED_TABLE_FORMAT      %d\n", TABLE_FORMAT);
+  printf("#define FIXED_DISPLAY_SIZE      %d\n", displaySize);
+  printf("#define FIXED_EYE_RADIUS        %d\n", tables.eyeRadius);
+  printf("#define FIXED_IRIS_RADIUS       %d\n", tables.irisRadius);
+  printf("#define FIXED_SLIT_PUPIL_RADIUS %d\n", tables.slitPupilRadius);
+  printf("#define FIXED_MAP_RADIUS        %d\n", tables.mapRadius);
+  printf("#define FIXED_OCTANT            %s\n\n", tables.octant ? "true" : "false");
+  printf("#if FIXED_TABLE_FORMAT != TABLE_FORMAT\n");
+  printf("  #error \"fixedtables.h 已过期，请用 tools/bakeeye 重新生成\"\n");
+  printf("#endif\n\n");
+  printf("static const uint8_t fixedDisplace[%d] = {\n", displaceBytes);
+  printBytes(tables.displace, displaceBytes);
+  printf("};\n\n");
+  printf("// 每个条目为 { angle, dist }\n");
+  printf("static const polarEntry fixedPolar[%d] = {\n",
+    polarBytes / (int)sizeof(polarEntry));
+  for(int i=0; i<polarBytes / (int)sizeof(polarEntry); i++) {
+    printf("%s{%d,%d},%s", (i & 7) ? " " : "  ", tables.polar[i].angle,
+      tables.polar[i].dist, ((i & 7) == 7) ? "\n" : "");
+  }
+  printf("%s};\n", ((polarBytes / (int)sizeof(polarEntry)) & 7) ? "\n" : "");
+
+  fprintf(stderr, "%d bytes of tables (polar %d, displacement %d)\n",
+    polarBytes + displaceBytes, polarBytes, displaceBytes);
+  return 0;
+}
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 将 BMP 纹理（24 位、16 位 565/555 或 4/8 位调色板）转换为 .tex 格式
+// （见 texfile.h）。
+// .tex 文件的像素已经是屏幕字节序的 RGB565，固件可以直接流式写入闪存，
+// 不需要像 BMP 那样先在 RAM 中解码整幅图像。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o bmp2tex bmp2tex.cpp
+// 用法：
+//   ./bmp2tex [-p] iris.bmp iris.tex
+// 然后在 config.eye 中使用新文件名，例如 "irisTexture" : "hazel/iris.tex"。
+// -p 写入 8 位索引格式（闪存用量减半），图像（转换为 RGB565 之后）的颜色
+// 必须不超过 256 种；不做任何量化，所以渲染结果与 16 位格式完全相同。
+
+#include "../common/hosteye.h"
+
+int main(int argc, char *argv[]) {
+  bool indexed = (argc == 4) && !strcmp(argv[1], "-p");
+  if((argc != 3) && !indexed) {
+    fprintf(stderr, "Usage: %s [-p] in.bmp out.tex\n", argv[0]);
+    return 1;
+  }
+  const char *in = argv[argc - 2], *out = argv[argc - 1];
+
+  std::vector<uint16_t> pixels;
+  int                   w, h;
+  if(!loadBMP565(in, &w, &h, pixels, false)) {
+    fprintf(stderr, "Can't load %s (must be 24-, 16-, 8- or 4-bit BMP)\n", in);
+    return 1;
+  }
+  if((w > 65535) || (h > 65535)) {
+    fprintf(stderr, "%s is too large\n", in);
+    return 1;
+  }
+
+  std::string data;
+  if(!encodeTex(w, h, pixels, indexed, data)) {
+    fprintf(stderr, "%s has more than 256 colors, can't use -p\n", in);
+    return 1;
+  }
+
+  FILE *fp = fopen(out, "wb");
+  if(!fp) {
+    fprintf(stderr, "Can't create %s\n", out);
+    return 1;
+  }
+  fwrite(data.data(), 1, data.size(), fp);
+  if(fclose(fp)) {
+    fprintf(stderr, "Error writing %s\n", out);
+    return 1;
+  }
+  printf("%s: %dx%d%s, %d bytes\n", out, w, h, indexed ? " indexed" : "",
+    (int)data.size());
+  return 0;
+}
@@ -0,0 +1,545 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 主机端工具（tools/ 下）共用的辅助代码：一个足以读取 config.eye 的小型
+// JSON 解析器（支持 // 和 /* */ 注释，与 ARDUINOJSON_ENABLE_COMMENTS 相同），
+// 一个模仿 file.cpp 中 loadConfig() 的预设读取器，BMP 和 .tex 读取器，
+// 以及各工具共用的纹理加载和逐帧眼睛运动（使结果可以互相比较）。
+// 这些只在工作站上使用，Arduino IDE 不会编译 tools/ 下的任何内容。
+
+#ifndef __HOSTEYE_H
+#define __HOSTEYE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "../../texfile.h"
+#include "../../render.h"
+#include "../../heapstat.h"
+
+// JSON ------------------------------------------------------------------
+
+struct jsonValue {
+  enum { NONE, NUMBER, STRING, BOOL, ARRAY, OBJECT } type = NONE;
+  double                           num    = 0.0;
+  bool                             isInt  = false;
+  bool                             b      = false;
+  std::string                      str;
+  std::vector<jsonValue>           arr;
+  std::map<std::string, jsonValue> obj;
+
+  // 与 ArduinoJson 类似，查找不存在的键返回一个 NONE 值而不是出错
+  const jsonValue &operator[](const char *key) const {
+    static const jsonValue none;
+    if(type != OBJECT) return none;
+    std::map<std::string, jsonValue>::const_iterator i = obj.find(key);
+    return (i == obj.end()) ? none : i->second;
+  }
+};
+
+class jsonParser {
+ public:
+  jsonParser(const std::string &text) : s(text), pos(0) { }
+  bool parse(jsonValue &v) { return value(v); }
+ private:
+  const std::string &s;
+  size_t             pos;
+
+  void skip(void) {
+    for(;;) {
+      while((pos < s.size()) && isspace((unsigned char)s[pos])) pos++;
+      if(!s.compare(pos, 2, "//")) {
+        while((pos < s.size()) && (s[pos] != '\n')) pos++;
+      } else if(!s.compare(pos, 2, "/*")) {
+        size_t e = s.find("*/", pos + 2);
+        pos = (e == std::string::npos) ? s.size() : e + 2;
+      } else {
+        return;
+      }
+    }
+  }
+  bool value(jsonValue &v) {
+    skip();
+    if(pos >= s.size()) return false;
+    char c = s[pos];
+    if(c == '{') {
+      v.type = jsonValue::OBJECT;
+      pos++;
+      skip();
+      if((pos < s.size()) && (s[pos] == '}')) { pos++; return true; }
+      for(;;) {
+        jsonValue key;
+        skip();
+        if(!value(key) || (key.type != jsonValue::STRING)) return false;
+        skip();
+        if((pos >= s.size()) || (s[pos++] != ':')) return false;
+        if(!value(v.obj[key.str])) return false;
+        skip();
+        if(pos >= s.size()) return false;
+        if(s[pos] == ',') { pos++; continue; }
+        if(s[pos] == '}') { pos++; return true; }
+        return false;
+      }
+    } else if(c == '[') {
+      v.type = jsonValue::ARRAY;
+      pos++;
+      skip();
+      if((pos < s.size()) && (s[pos] == ']')) { pos++; return true; }
+      for(;;) {
+        v.arr.push_back(jsonValue());
+        if(!value(v.arr.back())) return false;
+        skip();
+        if(pos >= s.size()) return false;
+        if(s[pos] == ',') { pos++; continue; }
+        if(s[pos] == ']') { pos++; return true; }
+        return false;
+      }
+    } else if(c == '"') {
+      v.type = jsonValue::STRING;
+      for(pos++; (pos < s.size()) && (s[pos] != '"'); pos++) {
+        if((s[pos] == '\\') && (pos + 1 < s.size())) pos++;
+        v.str += s[pos];
+      }
+      pos++;
+      return true;
+    } else if(!s.compare(pos, 4, "true")) {
+      v.type = jsonValue::BOOL; v.b = true;  pos += 4; return true;
+    } else if(!s.compare(pos, 5, "false")) {
+      v.type = jsonValue::BOOL; v.b = false; pos += 5; return true;
+    } else if(!s.compare(pos, 4, "null")) {
+      pos += 4; return true;
+    } else {
+      const char *start = s.c_str() + pos;
+      char       *end;
+      v.num = strtod(start, &end);
+      if(end == start) return false;
+      v.type  = jsonValue::NUMBER;
+      v.isInt = !memchr(start, '.', end - start) && !memchr(start, 'e', end - start);
+      pos    += end - start;
+      return true;
+    }
+  }
+};
+
+static inline bool readTextFile(const char *path, std::string &text) {
+  FILE *fp = fopen(path, "rb");
+  if(!fp) return false;
+  char   buf[4096];
+  size_t n;
+  while((n = fread(buf, 1, sizeof buf, fp)) > 0) text.append(buf, n);
+  fclose(fp);
+  return true;
+}
+
+// 与 file.cpp 中的 dwim() 相同的规则：整数、浮点数、"0x" 十六进制字符串
+// 或 RGB 数组，返回的 16 位颜色为大端格式。
+static inline int32_t dwim(const jsonValue &v, int32_t def = 0) {
+  if(v.type == jsonValue::NUMBER) {
+    return v.isInt ? (int32_t)v.num : (int32_t)(v.num + 0.5);
+  } else if(v.type == jsonValue::STRING) {
+    if((v.str.size() == 6) && !strncasecmp(v.str.c_str(), "0x", 2)) {
+      uint16_t rgb = strtol(v.str.c_str(), NULL, 0);
+      return __builtin_bswap16(rgb);
+    }
+    return strtol(v.str.c_str(), NULL, 0);
+  } else if(v.type == jsonValue::ARRAY) {
+    if(v.arr.size() >= 3) {
+      long cc[3] = { 0, 0, 0 };
+      for(int i=0; i<3; i++) {
+        const jsonValue &c = v.arr[i];
+        if(c.type == jsonValue::NUMBER) {
+          cc[i] = c.isInt ? (long)c.num : (long)(c.num * 255.999);
+        } else if(c.type == jsonValue::STRING) {
+          cc[i] = strtol(c.str.c_str(), NULL, 0);
+        }
+        if(cc[i] > 255)    cc[i] = 255;
+        else if(cc[i] < 0) cc[i] = 0;
+      }
+      uint16_t rgb = ((cc[0] & 0xF8) << 8) | ((cc[1] & 0xFC) << 3) | (cc[2] >> 3);
+      return __builtin_bswap16(rgb);
+    }
+    return v.arr.size() ? dwim(v.arr[0], def) : def;
+  }
+  return def;
+}
+
+// 预设 ------------------------------------------------------------------
+
+// loadConfig() 为一只眼睛产生的、与渲染有关的设置
+struct presetConfig {
+  std::string root;            // 文件系统根目录（纹理路径相对于此）
+  int         eyeRadius       = 0;
+  int         irisRadius      = 60;
+  int         slitPupilRadius = 0;
+  float       coverage        = 0.6;
+  int         mapRadius       = 0;
+  uint8_t     eyelidIndex     = 0;
+  uint16_t    pupilColor      = 0x0000;
+  uint16_t    backColor       = 0xFFFF;
+  uint16_t    irisColor       = 0xFF01;
+  uint16_t    scleraColor     = 0xFFFF;
+  uint16_t    irisMirror      = 0;
+  uint16_t    scleraMirror    = 0;
+  uint16_t    irisAngle       = 0;
+  uint16_t    scleraAngle     = 0;
+  uint16_t    irisiSpin       = 0;
+  uint16_t    scleraiSpin     = 0;
+  float       irisSpin        = 0.0;
+  float       scleraSpin      = 0.0;
+  float       irisMin         = 0.45;
+  float       irisRange       = 0.35;
+  std::string irisTexture;
+  std::string scleraTexture;
+  std::string upperEyelid;
+  std::string lowerEyelid;
+  jsonValue   doc;             // 完整的已解析文档
+};
+
+static inline void presetAngle(const jsonValue &v, uint16_t *angle) {
+  if(v.type != jsonValue::NUMBER) return;
+  if(v.isInt) *angle = 1023 - ((int)v.num & 1023);
+  else        *angle = 1023 - ((int)(v.num * 1024.0) & 1023);
+}
+
+static inline void presetEye(const jsonValue &d, presetConfig *cfg) {
+  cfg->pupilColor  = dwim(d["pupilColor"] , cfg->pupilColor);
+  cfg->backColor   = dwim(d["backColor"]  , cfg->backColor);
+  cfg->irisColor   = dwim(d["irisColor"]  , cfg->irisColor);
+  cfg->scleraColor = dwim(d["scleraColor"], cfg->scleraColor);
+  presetAngle(d["irisAngle"]  , &cfg->irisAngle);
+  presetAngle(d["scleraAngle"], &cfg->scleraAngle);
+  const jsonValue *v;
+  v = &d["irisSpin"];
+  if(v->type == jsonValue::NUMBER) cfg->irisSpin    = v->num * -1024.0;
+  v = &d["scleraSpin"];
+  if(v->type == jsonValue::NUMBER) cfg->scleraSpin  = v->num * -1024.0;
+  v = &d["irisiSpin"];
+  if(v->type == jsonValue::NUMBER) cfg->irisiSpin   = (int)v->num;
+  v = &d["scleraiSpin"];
+  if(v->type == jsonValue::NUMBER) cfg->scleraiSpin = (int)v->num;
+  v = &d["irisMirror"];
+  if((v->type == jsonValue::BOOL) || (v->type == jsonValue::NUMBER))
+    cfg->irisMirror   = (v->b || v->num) ? 1023 : 0;
+  v = &d["scleraMirror"];
+  if((v->type == jsonValue::BOOL) || (v->type == jsonValue::NUMBER))
+    cfg->scleraMirror = (v->b || v->num) ? 1023 : 0;
+  v = &d["irisTexture"];
+  if(v->type == jsonValue::STRING) cfg->irisTexture   = v->str;
+  v = &d["scleraTexture"];
+  if(v->type == jsonValue::STRING) cfg->scleraTexture = v->str;
+  // 每只眼睛的几何参数（与 loadConfig() 相同）
+  v = &d["eyeRadius"];
+  if(v->type != jsonValue::NONE) cfg->eyeRadius       = abs(dwim(*v));
+  v = &d["irisRadius"];
+  if(v->type != jsonValue::NONE) cfg->irisRadius      = abs(dwim(*v));
+  v = &d["slitPupilRadius"];
+  if(v->type != jsonValue::NONE) cfg->slitPupilRadius = abs(dwim(*v));
+  v = &d["coverage"];
+  if(v->type == jsonValue::NUMBER) cfg->coverage = v->num;
+}
+
+// 读取一个预设。'path' 可以是 config.eye 文件或包含它的目录，
+// 纹理路径相对于该目录的上一级（与开发板上 CIRCUITPY 驱动器的布局相同）。
+// 'eyeName' 为 "left"、"right" 或 NULL（仅使用全局值）。
+static inline bool loadPreset(const char *path, int displaySize,
+  const char *eyeName, presetConfig *cfg) {
+  std::string file = path, text;
+  if(!strstr(path, ".eye")) {
+    if(file.size() && (file[file.size() - 1] != '/')) file += '/';
+    file += "config.eye";
+  }
+  if(!readTextFile(file.c_str(), text)) {
+    fprintf(stderr, "Can't open %s\n", file.c_str());
+    return false;
+  }
+  jsonParser p(text);
+  if(!p.parse(cfg->doc) || (cfg->doc.type != jsonValue::OBJECT)) {
+    fprintf(stderr, "Config file error in %s\n", file.c_str());
+    return false;
+  }
+  size_t slash = file.rfind('/');
+  std::string dir = (slash == std::string::npos) ? "." : file.substr(0, slash);
+  slash = dir.rfind('/');
+  cfg->root = (slash == std::string::npos) ? "." : dir.substr(0, slash);
+
+  const jsonValue &doc = cfg->doc;
+  cfg->eyeRadius       = dwim(doc["eyeRadius"]);
+  cfg->eyelidIndex     = dwim(doc["eyelidIndex"]);
+  cfg->irisRadius      = dwim(doc["irisRadius"]);
+  cfg->slitPupilRadius = dwim(doc["slitPupilRadius"]);
+  if(doc["coverage"].type == jsonValue::NUMBER) cfg->coverage = doc["coverage"].num;
+  if(doc["upperEyelid"].type == jsonValue::STRING) cfg->upperEyelid = doc["upperEyelid"].str;
+  if(doc["lowerEyelid"].type == jsonValue::STRING) cfg->lowerEyelid = doc["lowerEyelid"].str;
+  float pMax = 1.0 - cfg->irisMin, pMin = 1.0 - (cfg->irisMin + cfg->irisRange);
+  if(doc["pupilMax"].type == jsonValue::NUMBER) pMax = doc["pupilMax"].num;
+  if(doc["pupilMin"].type == jsonValue::NUMBER) pMin = doc["pupilMin"].num;
+  pMin = fminf(fmaxf(pMin, 0.0), 1.0);
+  pMax = fminf(fmaxf(pMax, 0.0), 1.0);
+  if(pMin > pMax) { float t = pMin; pMin = pMax; pMax = t; }
+  cfg->irisMin   = 1.0 - pMax;
+  cfg->irisRange = pMax - pMin;
+
+  presetEye(doc, cfg);
+  if(eyeName) presetEye(doc[eyeName], cfg);
+
+  // 与 loadConfig() 末尾相同的默认值和限制
+  if(!cfg->eyeRadius) cfg->eyeRadius = displaySize / 2 + 5;
+  else                cfg->eyeRadius = abs(cfg->eyeRadius);
+  if(!cfg->irisRadius) cfg->irisRadius = displaySize / 4;
+  else                 cfg->irisRadius = abs(cfg->irisRadius);
+  cfg->slitPupilRadius = abs(cfg->slitPupilRadius);
+  if(cfg->slitPupilRadius > cfg->irisRadius) cfg->slitPupilRadius = cfg->irisRadius;
+  if(cfg->coverage < 0.0)      cfg->coverage = 0.0;
+  else if(cfg->coverage > 1.0) cfg->coverage = 1.0;
+  cfg->mapRadius = (int)(cfg->eyeRadius * M_PI * cfg->coverage + 0.5);
+  return true;
+}
+
+// BMP -------------------------------------------------------------------
+
+static inline uint16_t rd16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint32_t rd32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 将 24 位、16 位（565 或 555）或 4/8 位调色板 BMP 读入从上到下排列的
+// RGB565 像素（调色板图像展开为颜色，见 paletteize()）。
+// 'swap' 为 true 时按大端格式存储（与开发板上 byteSwap() 之后相同）。
+static inline bool loadBMP565(const char *path, int *width, int *height,
+  std::vector<uint16_t> &pixels, bool swap = true) {
+  std::string data;
+  if(!readTextFile(path, data) || (data.size() < 54)) return false;
+  const uint8_t *b = (const uint8_t *)data.data();
+  if((b[0] != 'B') || (b[1] != 'M')) return false;
+  uint32_t offset = rd32(b + 10);
+  int32_t  w      = (int32_t)rd32(b + 18), h = (int32_t)rd32(b + 22);
+  uint16_t depth  = rd16(b + 28);
+  uint32_t comp   = rd32(b + 30);
+  bool     flip   = true; // BMP 通常从下到上存储
+  if(h < 0) { h = -h; flip = false; }
+  if((w <= 0) || ((depth != 24) && (depth != 16) && (depth != 8) && (depth != 4)) ||
+     ((comp != 0) && ((comp != 3) || (depth < 16)))) return false;
+  bool     is565  = (depth == 16) && (comp == 3) && (rd32(b + 54) == 0xF800);
+  uint32_t rowSize = ((w * depth + 31) / 32) * 4;
+  if(offset + rowSize * h > data.size()) return false;
+  uint16_t palette[256] = { 0 }; // 与固件中的 readBMPPalette() 相同
+  if(depth <= 8) {
+    uint32_t colors = rd32(b + 46), palOffset = 14 + rd32(b + 14);
+    if(!colors || (colors > (1u << depth))) colors = 1 << depth;
+    if(palOffset + colors * 4 > data.size()) return false;
+    for(uint32_t i=0; i<colors; i++) {
+      const uint8_t *p = b + palOffset + i * 4; // B, G, R, 0
+      palette[i] = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+    }
+  }
+  pixels.resize((size_t)w * h);
+  for(int y=0; y<h; y++) {
+    const uint8_t *row = b + offset + (flip ? (h - 1 - y) : y) * rowSize;
+    for(int x=0; x<w; x++) {
+      uint16_t c;
+      if(depth == 24) {
+        const uint8_t *p = row + x * 3; // B, G, R
+        c = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+      } else if(depth == 8) {
+        c = palette[row[x]];
+      } else if(depth == 4) {
+        c = palette[(x & 1) ? (row[x / 2] & 0x0F) : (row[x / 2] >> 4)];
+      } else if(is565) {
+        c = rd16(row + x * 2);
+      } else { // 555
+        uint16_t p = rd16(row + x * 2);
+        c = ((p & 0x7FE0) << 1) | ((p & 0x0200) >> 4) | (p & 0x001F);
+      }
+      pixels[(size_t)y * w + x] = swap ? __builtin_bswap16(c) : c;
+    }
+  }
+  *width  = w;
+  *height = h;
+  return true;
+}
+
+// 读取 .tex 纹理（见 texfile.h）。像素在文件中是大端格式，'swap' 的含义
+// 与 loadBMP565() 相同。索引格式展开为颜色。
+static inline bool loadTex565(const char *path, int *width, int *height,
+  std::vector<uint16_t> &pixels, bool swap = true) {
+  std::string data;
+  if(!readTextFile(path, data) || (data.size() < sizeof(texHeader))) return false;
+  const uint8_t *b = (const uint8_t *)data.data();
+  int  w = rd16(b + 4), h = rd16(b + 6);
+  bool indexed = (b[8] == TEX_FORMAT_INDEXED8);
+  if((rd32(b) != TEX_MAGIC) || ((b[8] != TEX_FORMAT_RGB565) && !indexed) || !w || !h ||
+     (data.size() < sizeof(texHeader) + (indexed ? 512 : 0) +
+     (size_t)w * h * (indexed ? 1 : 2))) return false;
+  pixels.resize((size_t)w * h);
+  for(size_t i=0; i<pixels.size(); i++) {
+    const uint8_t *p = indexed ?
+      b + sizeof(texHeader) + b[sizeof(texHeader) + 512 + i] * 2 :
+      b + sizeof(texHeader) + i * 2;
+    uint16_t       c = (p[0] << 8) | p[1];
+    pixels[i] = swap ? __builtin_bswap16(c) : c;
+  }
+  *width  = w;
+  *height = h;
+  return true;
+}
+
+// 按文件扩展名读取 BMP 或 .tex 纹理，与固件中的 loadTexture() 相同
+static inline bool loadImage565(const char *path, int *width, int *height,
+  std::vector<uint16_t> &pixels, bool swap = true) {
+  size_t len = strlen(path);
+  if((len > 4) && !strcasecmp(path + len - 4, ".tex")) {
+    return loadTex565(path, width, height, pixels, swap);
+  }
+  return loadBMP565(path, width, height, pixels, swap);
+}
+
+// 文件是否为调色板图像（4/8 位 BMP 或索引 .tex），固件会把它加载为
+// 8 位索引纹理
+static inline bool imageIsIndexed(const char *path) {
+  uint8_t b[30];
+  FILE   *fp = fopen(path, "rb");
+  if(!fp) return false;
+  size_t n = fread(b, 1, sizeof b, fp);
+  fclose(fp);
+  if((n >= sizeof(texHeader)) && (rd32(b) == TEX_MAGIC)) return b[8] == TEX_FORMAT_INDEXED8;
+  return (n == sizeof b) && (b[0] == 'B') && (b[1] == 'M') && (rd16(b + 28) <= 8);
+}
+
+// 将像素转换为 8 位索引和调色板（按首次出现的顺序），不做任何量化：
+// 颜色超过 256 种时返回 false。
+static inline bool paletteize(const std::vector<uint16_t> &pixels,
+  std::vector<uint8_t> &index, std::vector<uint16_t> &palette) {
+  std::map<uint16_t, uint8_t> slot;
+  palette.assign(256, 0);
+  index.resize(pixels.size());
+  for(size_t i=0; i<pixels.size(); i++) {
+    std::map<uint16_t, uint8_t>::iterator it = slot.find(pixels[i]);
+    if(it == slot.end()) {
+      if(slot.size() == 256) return false;
+      uint8_t n = slot.size();
+      it = slot.insert(std::make_pair(pixels[i], n)).first;
+      palette[n] = pixels[i];
+    }
+    index[i] = it->second;
+  }
+  return true;
+}
+
+// 生成 .tex 文件的内容（见 texfile.h）。'pixels' 是主机字节序的 RGB565
+// （loadBMP565() 的 swap = false）；'indexed' 为 true 时写入 8 位索引格式，
+// 颜色超过 256 种时返回 false。文件头逐字节生成，与主机字节序无关。
+static inline bool encodeTex(int w, int h, const std::vector<uint16_t> &pixels,
+  bool indexed, std::string &out) {
+  std::vector<uint16_t> palette;
+  std::vector<uint8_t>  index;
+  if(indexed && !paletteize(pixels, index, palette)) return false;
+  uint8_t hdr[sizeof(texHeader)] = { 0 };
+  hdr[0] = TEX_MAGIC & 0xFF;
+  hdr[1] = (TEX_MAGIC >>  8) & 0xFF;
+  hdr[2] = (TEX_MAGIC >> 16) & 0xFF;
+  hdr[3] = (TEX_MAGIC >> 24) & 0xFF;
+  hdr[4] = w & 0xFF;
+  hdr[5] = w >> 8;
+  hdr[6] = h & 0xFF;
+  hdr[7] = h >> 8;
+  hdr[8] = indexed ? TEX_FORMAT_INDEXED8 : TEX_FORMAT_RGB565;
+  out.assign((const char *)hdr, sizeof hdr);
+  const std::vector<uint16_t> &colors = indexed ? palette : pixels;
+  for(size_t i=0; i<colors.size(); i++) {
+    out += (char)(colors[i] >> 8); // 大端
+    out += (char)colors[i];
+  }
+  out.append(index.begin(), index.end());
+  return true;
+}
+
+// 渲染 ------------------------------------------------------------------
+
+// 加载纹理，或者（如果没有文件名或文件加载失败）像 setup() 一样
+// 将数据指向颜色变量并将图像大小设置为 1px。
+// 把逐行存储的图像重新排列为块布局（见 render.h），与固件的加载函数
+// 写入闪存的顺序相同：宽度填充为 TILE_WIDTH 的倍数（重复最后一列），
+// 最后一行块用最后一行像素填满。
+template<typename T>
+static inline std::vector<T> tileImage(const std::vector<T> &src, int w, int h,
+  int tileHeight) {
+  int pw = (w + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH;
+  int ph = (h + tileHeight - 1) / tileHeight * tileHeight;
+  std::vector<T> dst((size_t)pw * ph);
+  for(int y=0; y<ph; y++) {
+    for(int x=0; x<pw; x++) {
+      dst[tiledOffset(w, tileHeight, x, y)] =
+        src[(size_t)std::min(y, h - 1) * w + std::min(x, w - 1)];
+    }
+  }
+  return dst;
+}
+
+// 加载预设的一个纹理。forceIndexed 把颜色不超过 256 种的纹理转为索引纹理，
+// tiled 按块布局存储（与 config.eye 中的 "tileTextures" 相同）。
+static inline void loadPresetTexture(const presetConfig &cfg, const std::string &name,
+  texture *tex, std::vector<uint16_t> &pixels, std::vector<uint8_t> &index,
+  bool forceIndexed, bool tiled = false) {
+  std::string path = cfg.root + "/" + name;
+  int         w, h;
+  if(name.size() && loadImage565(path.c_str(), &w, &h, pixels)) {
+    tex->data   = pixels.data();
+    tex->width  = w;
+    tex->height = h;
+    std::vector<uint16_t> palette;
+    if((forceIndexed || imageIsIndexed(path.c_str())) &&
+       paletteize(pixels, index, palette)) {
+      pixels      = palette; // 像素已在 index 中
+      tex->data   = pixels.data();
+      tex->index  = index.data();
+    }
+    if(tiled) {
+      tex->tileHeight = TILE_BYTES / (TILE_WIDTH * (tex->index ? 1 : 2));
+      if(prepareTiles(tex)) {
+        if(tex->index) {
+          index      = tileImage(index, w, h, tex->tileHeight);
+          tex->index = index.data();
+        } else {
+          pixels     = tileImage(pixels, w, h, tex->tileHeight);
+          tex->data  = pixels.data();
+        }
+      }
+    }
+  } else {
+    if(name.size()) fprintf(stderr, "Can't load texture %s, using color\n", name.c_str());
+    tex->data  = &tex->color;
+    tex->width = tex->height = 1;
+  }
+}
+
+// 设置第 f 帧的眼睛状态和纹理旋转。眼睛沿固定路径移动，瞳孔大小和
+// 纹理旋转也随之变化，所以每个工具对同一预设得到相同的帧序列。
+static inline void presetFrame(const presetConfig &cfg, const eyeTables *tables,
+  int f, texture *iris, texture *sclera, eyeRenderState *state) {
+  // 眼睛可以在极坐标地图上移动的半径，与 loop() 中的“大”眼跳相同
+  float r = ((float)tables->mapDiameter - (float)tables->displaySize * M_PI_2) * 0.75;
+  float a = (float)f * 0.0137;
+  float eyeX = tables->mapRadius + r * cosf(a * 3.0) * 0.7;
+  float eyeY = tables->mapRadius + r * sinf(a * 2.0) * 0.7;
+  float pupilFactor = cfg.irisMin + cfg.irisRange * (0.5 + 0.5 * sinf(a * 5.0));
+  iris->angle   = cfg.irisiSpin   ? (uint16_t)(cfg.irisAngle   + cfg.irisiSpin   * f) :
+                  (uint16_t)(cfg.irisAngle   + cfg.irisSpin   * f / 3600.0 + 0.5);
+  sclera->angle = cfg.scleraiSpin ? (uint16_t)(cfg.scleraAngle + cfg.scleraiSpin * f) :
+                  (uint16_t)(cfg.scleraAngle + cfg.scleraSpin * f / 3600.0 + 0.5);
+  // 与 loop() 相同的每帧计算
+  state->xPosition    = (int)(eyeX - (tables->displaySize/2.0));
+  state->yPosition    = (int)(eyeY - (tables->displaySize/2.0));
+  state->iPupilFactor = (int)((float)iris->height * 256 * (1.0 / pupilFactor));
+}
+
+#endif // __HOSTEYE_H
@@ -0,0 +1,193 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 主机端列渲染基准测试。使用与固件完全相同的 render.cpp 和 tablegen.cpp，
+// 为选定的 eyes/*/config.eye 生成表、加载纹理，然后渲染数千帧，
+// 报告每像素纳秒数和每秒列数。用于在工作站上测量每次内核更改。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o eyebench eyebench.cpp ../../render.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./eyebench [-f frames] [-s displaysize] [-e left|right] [-d out.ppm] [-p] [-t] [-r] ../../eyes/hazel
+//
+// 眼睛在每帧中沿固定路径移动，瞳孔大小和纹理旋转也随之变化，
+// 因此结果是确定性的；最后打印的校验和可用于确认内核更改
+// 没有改变渲染输出。
+//
+// 与固件一样，调色板图像（4/8 位 BMP 或索引 .tex）作为 8 位索引纹理渲染。
+// -p 把颜色不超过 256 种的其他纹理也转为索引纹理，用于比较两种内核
+// （输出相同，校验和也相同）。-t 按块布局存储纹理（config.eye 中的
+// "tileTextures"），校验和同样不变。-r 像 HalloWing 一样记录纯色段
+// （eyeRenderState.runs，渲染器不写入这些像素），计时之后再把它们填入帧，
+// 校验和不变，并报告省去的像素比例；-P 同时查找瞳孔的纯色段（config.eye
+// 中的 "pupilRuns"，包括 -r）。
+
+#include <time.h>
+#include <unistd.h>
+#include "../common/hosteye.h"
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-f frames] [-s displaysize] [-e left|right] "
+    "[-d out.ppm] [-p] [-t] [-r] [-P] preset_dir|config.eye\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int         frames      = 2000;
+  int         displaySize = 240;
+  const char *eyeName     = NULL;
+  const char *dumpFile    = NULL;
+  bool        indexed     = false;
+  bool        tiled       = false;
+  bool        runs        = false;
+  bool        pupilRuns   = false;
+  int         opt;
+
+  while((opt = getopt(argc, argv, "f:s:e:d:ptrP")) != -1) {
+    switch(opt) {
+     case 'f': frames      = atoi(optarg); break;
+     case 's': displaySize = atoi(optarg); break;
+     case 'e': eyeName     = optarg;       break;
+     case 'd': dumpFile    = optarg;       break;
+     case 'p': indexed     = true;         break;
+     case 't': tiled       = true;         break;
+     case 'r': runs        = true;         break;
+     case 'P': runs        = pupilRuns = true; break;
+     default : usage(argv[0]);
+    }
+  }
+  if((optind >= argc) || (frames < 1) || (displaySize < 2) || (displaySize > 240)) usage(argv[0]);
+
+  presetConfig cfg;
+  if(!loadPreset(argv[optind], displaySize, eyeName, &cfg)) return 1;
+
+  // 表 -----------------------------------------------------------------
+
+  eyeTables tables = { 0 };
+  tables.displaySize     = displaySize;
+  tables.eyeRadius       = cfg.eyeRadius;
+  tables.irisRadius      = cfg.irisRadius;
+  tables.slitPupilRadius = cfg.slitPupilRadius;
+  tables.mapRadius       = cfg.mapRadius;
+  tables.mapDiameter     = cfg.mapRadius * 2;
+  double t0 = now();
+  calcMap(&tables);
+  double t1 = now();
+  calcDisplacement(&tables);
+  double t2 = now();
+  if(!tables.polar || !tables.displace) {
+    fprintf(stderr, "Table allocation failed\n");
+    return 1;
+  }
+
+  printf("preset    : %s%s%s\n", argv[optind], eyeName ? " eye " : "", eyeName ? eyeName : "");
+  printf("geometry  : eyeRadius %d, irisRadius %d, slitPupilRadius %d, mapRadius %d\n",
+    tables.eyeRadius, tables.irisRadius, tables.slitPupilRadius, tables.mapRadius);
+  printf("tables    : calcMap %.1f ms, calcDisplacement %.1f ms\n",
+    (t1 - t0) * 1e3, (t2 - t1) * 1e3);
+  printf("polar map : %d bytes (%s; full quadrant %d bytes)\n",
+    polarMapSize(&tables, tables.octant), tables.octant ? "octant" : "quadrant",
+    polarMapSize(&tables, false));
+
+  // 纹理和眼睛状态 -----------------------------------------------------
+
+  texture               iris = { 0 }, sclera = { 0 };
+  std::vector<uint16_t> irisPixels, scleraPixels;
+  std::vector<uint8_t>  irisIndex, scleraIndex;
+  iris.color   = cfg.irisColor;
+  sclera.color = cfg.scleraColor;
+  loadPresetTexture(cfg, cfg.irisTexture  , &iris  , irisPixels  , irisIndex  , indexed, tiled);
+  loadPresetTexture(cfg, cfg.scleraTexture, &sclera, scleraPixels, scleraIndex, indexed, tiled);
+  iris.mirror   = cfg.irisMirror;
+  sclera.mirror = cfg.scleraMirror;
+  prepareTexture(&iris);
+  prepareTexture(&sclera);
+  printf("textures  : iris %dx%d%s%s, sclera %dx%d%s%s\n",
+    iris.width, iris.height, iris.index ? " indexed" : "", iris.tileHeight ? " tiled" : "",
+    sclera.width, sclera.height, sclera.index ? " indexed" : "", sclera.tileHeight ? " tiled" : "");
+  columnRenderer renderer = selectRenderer(&iris, &sclera);
+
+  eyeRenderState state;
+  state.pupilColor  = cfg.pupilColor;
+  state.backColor   = cfg.backColor;
+  state.eyelidColor = cfg.eyelidIndex * 0x0101;
+  state.iris        = &iris;
+  state.sclera      = &sclera;
+  state.runs        = NULL;
+  state.pupilRuns   = pupilRuns;
+
+  // 渲染 ---------------------------------------------------------------
+
+  std::vector<uint16_t>  frame((size_t)displaySize * displaySize);
+  std::vector<colorRuns> columnRuns(displaySize);
+  double   elapsed  = 0.0;
+  uint32_t checksum = 2166136261u;
+  uint64_t runPixels = 0, runCount = 0;
+  for(int f=0; f<frames; f++) {
+    presetFrame(cfg, &tables, f, &iris, &sclera, &state);
+
+    double ts = now();
+    for(int x=0; x<displaySize; x++) {
+      if(runs) state.runs = &columnRuns[x];
+      renderer(&tables, &state, x, 0, displaySize - 1, &frame[(size_t)x * displaySize]);
+    }
+    elapsed += now() - ts;
+
+    for(int x=0; runs && (x<displaySize); x++) { // 纯色段，相当于 DMA 发出的像素
+      const colorRuns *cr = &columnRuns[x];
+      for(int i=0; i<cr->count; i++) {
+        const colorRun *r = &cr->run[i];
+        uint16_t color = (r->kind == RUN_PUPIL) ? state.pupilColor :
+                         (r->kind == RUN_BACK ) ? state.backColor  : state.eyelidColor;
+        for(int y=r->y; y<(r->y + r->count); y++) frame[(size_t)x * displaySize + y] = color;
+        runPixels += r->count;
+      }
+      runCount += cr->count;
+    }
+
+    for(size_t i=0; i<frame.size(); i++) { // FNV-1a，在计时之外
+      checksum = (checksum ^ frame[i]) * 16777619u;
+    }
+  }
+
+  double columns = (double)frames * displaySize;
+  double pixels  = columns * displaySize;
+  printf("rendered  : %d frames, %.0f columns, %.0f pixels in %.3f s\n",
+    frames, columns, pixels, elapsed);
+  printf("speed     : %.2f ns/pixel, %.0f columns/sec, %.1f frames/sec\n",
+    elapsed * 1e9 / pixels, columns / elapsed, frames / elapsed);
+  if(runs) {
+    printf("runs      : %.1f%% of pixels, %.2f runs/column\n",
+      runPixels * 100.0 / pixels, runCount / columns);
+  }
+  printf("checksum  : %08X\n", checksum);
+
+  if(dumpFile) { // 最后一帧，转换为常规的从上到下方向
+    FILE *fp = fopen(dumpFile, "wb");
+    if(fp) {
+      fprintf(fp, "P6\n%d %d\n255\n", displaySize, displaySize);
+      for(int y=displaySize-1; y>=0; y--) {     // 屏幕 +Y 向上（见 M4_Eyes.ino）
+        for(int x=0; x<displaySize; x++) {
+          uint16_t c = __builtin_bswap16(frame[(size_t)x * displaySize + y]);
+          uint8_t  rgb[3] = { (uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC),
+                              (uint8_t)(c << 3) };
+          fwrite(rgb, 1, 3, fp);
+        }
+      }
+      fclose(fp);
+    }
+  }
+
+  heapFree((void *)tables.polar);
+  heapFree((void *)tables.displace);
+  return 0;
+}
@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 把一个预设（config.eye 和它引用的纹理、眼睑）编译成一个眼睛包（.eyp，
+// 见 eyepack.h）。固件启动时不再逐个打开文件、解析 BMP 头、逐行转换纹理
+// 和扫描眼睑：纹理已经是 .tex 格式，眼睑已经是每列的最小/最大值数组，
+// 加上 -t 时表也已经生成好。把包复制到 CIRCUITPY 驱动器，文件名与配置
+// 文件相同（config.eye -> config.eyp，config1.eye -> config1.eyp，等等）；
+// 原来的文件可以保留，包中没有的资源仍然从那里加载。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o eyepack eyepack.cpp ../../render.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./eyepack [-s displaysize] [-n eyes] [-p] [-t] ../../eyes/hazel config.eyp
+// -s 是眼睑和表的屏幕大小（MONSTER M4SK 和 HalloWing 都是 240），与开发板
+// 不同时固件忽略包中的眼睑和表。-n 1 只打包全局的纹理（HalloWing），默认 2
+// 还包括 "left" 和 "right" 中的纹理。-p 与 bmp2tex 相同，把颜色不超过
+// 256 种的纹理存为 8 位索引格式（4/8 位调色板 BMP 总是如此）。-t 加入每种
+// 不同几何的表，首次启动也不需要运行 calcMap() 和 calcDisplacement()；
+// 表的格式（TABLE_FORMAT）改变后需要重新生成包。
+
+#include <unistd.h>
+#include "../common/hosteye.h"
+#include "../../eyepack.h"
+
+// 一个条目和它的数据
+typedef struct {
+  eyePackEntry entry;
+  std::string  data;
+} packItem;
+
+static bool addItem(std::vector<packItem> &items, uint32_t type, const std::string &name,
+  uint32_t key, uint32_t param, const std::string &data) {
+  packItem item;
+  memset(&item.entry, 0, sizeof item.entry);
+  if(name.size() >= sizeof item.entry.name) {
+    fprintf(stderr, "File name %s is too long for a pack (%d characters max)\n",
+      name.c_str(), (int)sizeof item.entry.name - 1);
+    return false;
+  }
+  item.entry.type  = type;
+  item.entry.bytes = data.size();
+  item.entry.key   = key;
+  item.entry.param = param;
+  strcpy(item.entry.name, name.c_str());
+  item.data = data;
+  items.push_back(item);
+  return true;
+}
+
+// 纹理转换为 .tex（.tex 文件原样复制），与固件加载 BMP 时的格式相同：
+// 4/8 位调色板 BMP 为索引格式，其他为 RGB565（-p 时尽量用索引格式）。
+static bool packTexture(const presetConfig &cfg, const std::string &name,
+  bool indexed, std::string &data) {
+  std::string path = cfg.root + "/" + name;
+  size_t      len  = name.size();
+  if((len > 4) && !strcasecmp(name.c_str() + len - 4, ".tex")) {
+    return readTextFile(path.c_str(), data);
+  }
+  std::vector<uint16_t> pixels;
+  int                   w, h;
+  if(!loadBMP565(path.c_str(), &w, &h, pixels, false) || (w > 65535) || (h > 65535)) {
+    return false;
+  }
+  if((indexed || imageIsIndexed(path.c_str())) && encodeTex(w, h, pixels, true, data)) {
+    return true;
+  }
+  if(indexed) fprintf(stderr, "%s has more than 256 colors, stored as RGB565\n", name.c_str());
+  return encodeTex(w, h, pixels, false, data);
+}
+
+// 与固件的 loadEyelid() 相同：1 位 BMP 居中/裁剪到屏幕，每列的最小/最大 Y
+// （翻转之后）存入 minArray 和 maxArray，没有像素的列保持 'init'。
+static bool packEyelid(const char *path, int displaySize, uint8_t init,
+  uint8_t *minArray, uint8_t *maxArray) {
+  std::string data;
+  if(!readTextFile(path, data) || (data.size() < 62)) return false;
+  const uint8_t *b = (const uint8_t *)data.data();
+  if((b[0] != 'B') || (b[1] != 'M') || (rd16(b + 28) != 1) || rd32(b + 30)) return false;
+  uint32_t offset = rd32(b + 10), palOffset = 14 + rd32(b + 14);
+  int32_t  width  = (int32_t)rd32(b + 18), height = (int32_t)rd32(b + 22);
+  bool     flip   = true;
+  if(height < 0) { height = -height; flip = false; }
+  uint32_t rowBytes = ((width + 31) / 32) * 4;
+  if((width <= 0) || (palOffset + 8 > data.size()) ||
+     (offset + rowBytes * height > data.size())) return false;
+  uint16_t palette[2];
+  for(int i=0; i<2; i++) {
+    const uint8_t *p = b + palOffset + i * 4; // B, G, R, 0
+    palette[i] = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+  }
+  uint8_t white = (palette[1] > palette[0]);
+
+  memset(minArray, init, displaySize);
+  memset(maxArray, init, displaySize);
+  int sx1 = (displaySize - width) / 2, sy1 = (displaySize - height) / 2;
+  int sx2 = sx1 + width - 1, sy2 = sy1 + height - 1;
+  int ix  = -sx1, iy = -sy1;
+  if(sx1 < 0) sx1 = 0;
+  if(sy1 < 0) sy1 = 0;
+  if(sx2 > (displaySize - 1)) sx2 = displaySize - 1;
+  if(sy2 > (displaySize - 1)) sy2 = displaySize - 1;
+  if(ix < 0) ix = 0;
+  if(iy < 0) iy = 0;
+  std::vector<uint8_t> miny(displaySize, 255), maxy(displaySize, 0);
+  for(int y=sy1; y<=sy2; y++) {
+    int            iyy = iy + y - sy1;
+    const uint8_t *row = b + offset + (flip ? (height - 1 - iyy) : iyy) * rowBytes;
+    for(int x=sx1; x<=sx2; x++) {
+      int     bx   = ix + x - sx1;
+      uint8_t mask = 0x80 >> (bx & 7);
+      if((row[bx / 8] & mask) == (white ? mask : 0)) {
+        if(y < miny[x]) miny[x] = y;
+        if(y > maxy[x]) maxy[x] = y;
+      }
+    }
+  }
+  for(int x=sx1; x<=sx2; x++) {
+    if(miny[x] != 255) {
+      maxArray[x] = displaySize - 1 - miny[x];
+      minArray[x] = displaySize - 1 - maxy[x];
+    }
+  }
+  return true;
+}
+
+static int priority(const presetConfig &cfg, const char *eyeName, const char *key, int def) {
+  def = dwim(cfg.doc[key], def);
+  if(eyeName) def = dwim(cfg.doc[eyeName][key], def);
+  return (def < 0) ? 0 : (def > 255) ? 255 : def;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-s displaysize] [-n eyes] [-p] [-t] preset_dir|config.eye "
+    "out.eyp\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int  displaySize = 240;
+  int  numEyes     = 2;
+  bool indexed     = false;
+  bool tables      = false;
+  int  opt;
+
+  while((opt = getopt(argc, argv, "s:n:pt")) != -1) {
+    switch(opt) {
+     case 's': displaySize = atoi(optarg); break;
+     case 'n': numEyes     = atoi(optarg); break;
+     case 'p': indexed     = true;         break;
+     case 't': tables      = true;         break;
+     default : usage(argv[0]);
+    }
+  }
+  if(((optind + 2) != argc) || (displaySize < 2) || (displaySize > 240) ||
+     (numEyes < 1) || (numEyes > 2)) usage(argv[0]);
+  const char *in = argv[optind], *out = argv[optind + 1];
+
+  presetConfig cfg[2];
+  const char  *eyeName[2] = { NULL, NULL };
+  if(numEyes > 1) {
+    eyeName[0] = "left";
+    eyeName[1] = "right";
+  }
+  for(int e=0; e<numEyes; e++) {
+    if(!loadPreset(in, displaySize, eyeName[e], &cfg[e])) return 1;
+  }
+
+  std::vector<packItem> items;
+
+  // 配置文件的文本，固件仍然用 loadConfig() 解析
+  std::string path = in, text;
+  if(!strstr(in, ".eye")) {
+    if(path.size() && (path[path.size() - 1] != '/')) path += '/';
+    path += "config.eye";
+  }
+  readTextFile(path.c_str(), text);
+  if(!addItem(items, PACK_CONFIG, "config.eye", 0, 0, text)) return 1;
+
+  // 纹理，按 setup() 加载的顺序（优先级从高到低）
+  typedef struct {
+    std::string name;
+    int         priority;
+  } texName;
+  std::vector<texName> names;
+  for(int e=0; e<numEyes; e++) {
+    names.push_back({ cfg[e].irisTexture  , priority(cfg[e], eyeName[e], "irisPriority"  , 2) });
+    names.push_back({ cfg[e].scleraTexture, priority(cfg[e], eyeName[e], "scleraPriority", 1) });
+  }
+  std::stable_sort(names.begin(), names.end(), [](const texName &a, const texName &b) {
+    return a.priority > b.priority; });
+  for(size_t i=0; i<names.size(); i++) {
+    const std::string &name = names[i].name;
+    size_t             j;
+    for(j=0; (j < i) && (names[j].name != name); j++);
+    if(!name.size() || (j < i)) continue;
+    std::string data;
+    if(!packTexture(cfg[0], name, indexed, data)) {
+      fprintf(stderr, "Can't load texture %s, not packed\n", name.c_str());
+      continue;
+    }
+    uint32_t key = eyePackHash(2166136261u, data.data(), data.size());
+    if(!addItem(items, PACK_TEXTURE, name, key ? key : 1, 0, data)) return 1;
+  }
+
+  // 眼睑，'init' 与 setup() 中的 loadEyelid() 调用相同
+  for(int k=0; k<2; k++) {
+    std::string name = k ? cfg[0].lowerEyelid : cfg[0].upperEyelid;
+    if(!name.size()) name = k ? "lower.bmp" : "upper.bmp";
+    uint8_t              init = k ? 0 : displaySize - 1;
+    std::vector<uint8_t> minmax(displaySize * 2);
+    // 上眼睑：upperClosed, upperOpen；下眼睑：lowerOpen, lowerClosed
+    if(!packEyelid((cfg[0].root + "/" + name).c_str(), displaySize, init,
+       &minmax[0], &minmax[displaySize])) {
+      fprintf(stderr, "Can't load eyelid %s (must be 1-bit BMP), not packed\n", name.c_str());
+      continue;
+    }
+    if(!addItem(items, PACK_EYELID, name, 0, init,
+       std::string(minmax.begin(), minmax.end()))) return 1;
+  }
+
+  // 表，每种不同的几何一组
+  eyeTables set[2] = { 0 };
+  for(int e=0; tables && (e<numEyes); e++) {
+    eyeTables *t = &set[e];
+    t->displaySize     = displaySize;
+    t->eyeRadius       = cfg[e].eyeRadius;
+    t->irisRadius      = cfg[e].irisRadius;
+    t->slitPupilRadius = cfg[e].slitPupilRadius;
+    t->mapRadius       = cfg[e].mapRadius;
+    t->mapDiameter     = cfg[e].mapRadius * 2;
+    if(e && (tableKey(t) == tableKey(&set[0]))) continue;
+    calcMap(t);
+    calcDisplacement(t);
+    if(!t->polar || !t->displace) {
+      fprintf(stderr, "Can't generate tables for eye #%d\n", e);
+      return 1;
+    }
+    tableCacheHeader hdr;
+    memset(&hdr, 0, sizeof hdr);
+    hdr.magic         = TABLE_CACHE_MAGIC;
+    hdr.key           = tableKey(t);
+    hdr.polarBytes    = polarMapSize(t, t->octant);
+    hdr.displaceBytes = (displaySize / 2) * (displaySize / 2);
+    hdr.octant        = t->octant;
+    std::string data((const char *)&hdr, sizeof hdr);
+    data.append((const char *)t->polar, hdr.polarBytes);
+    data.append((const char *)t->displace, hdr.displaceBytes);
+    if(!addItem(items, PACK_TABLES, "", hdr.key, 0, data)) return 1;
+  }
+
+  // 写入：头、目录、然后各条目的数据（对齐到 EYEPACK_ALIGN）
+  eyePackHeader hdr;
+  memset(&hdr, 0, sizeof hdr);
+  hdr.magic       = EYEPACK_MAGIC;
+  hdr.version     = EYEPACK_VERSION;
+  hdr.entries     = items.size();
+  hdr.displaySize = displaySize;
+  uint32_t offset = sizeof hdr + items.size() * sizeof(eyePackEntry);
+  for(size_t i=0; i<items.size(); i++) {
+    offset = (offset + EYEPACK_ALIGN - 1) / EYEPACK_ALIGN * EYEPACK_ALIGN;
+    items[i].entry.offset = offset;
+    offset += items[i].entry.bytes;
+  }
+  std::string file((const char *)&hdr, sizeof hdr);
+  for(size_t i=0; i<items.size(); i++) {
+    file.append((const char *)&items[i].entry, sizeof items[i].entry);
+  }
+  for(size_t i=0; i<items.size(); i++) {
+    file.resize(items[i].entry.offset, 0);
+    file += items[i].data;
+  }
+  FILE *fp = fopen(out, "wb");
+  if(!fp) {
+    fprintf(stderr, "Can't create %s\n", out);
+    return 1;
+  }
+  fwrite(file.data(), 1, file.size(), fp);
+  if(fclose(fp)) {
+    fprintf(stderr, "Error writing %s\n", out);
+    return 1;
+  }
+
+  static const char *typeName[] = { "", "config", "texture", "eyelid", "tables" };
+  for(size_t i=0; i<items.size(); i++) {
+    const eyePackEntry &e = items[i].entry;
+    printf("%-8s %-28s %8d bytes at %8d\n", typeName[e.type],
+      e.name[0] ? e.name : "-", (int)e.bytes, (int)e.offset);
+  }
+  printf("%s: %d entries, %d bytes\n", out, (int)items.size(), (int)file.size());
+  return 0;
+}
@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 在工作站上重放一个预设在 setup() 中的堆分配，报告每个阶段之后的堆
+// （与开发板串口输出中的 heapReport() 相同），用于在烧录之前发现纹理、
+// 表或加载顺序的改动引起的碎片。分配来自 heapstat.cpp 模拟的 newlib-nano
+// 堆，大小取开发板启动时打印的“启动时可用 RAM”；表和块布局的地址表由与
+// 固件完全相同的 tablegen.cpp 和 render.cpp 分配，其他分配按 setup()、
+// memory.cpp 和 pdmvoice.cpp 的顺序和大小重放（修改那里的分配时同步修改
+// 这里）。库（Arcada、USB、文件系统）的分配不在其中。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o heapreplay heapreplay.cpp ../../render.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./heapreplay [-r ram] [-s displaysize] [-n eyes] [-k stackreserve] [-m maxfrag]
+//                [-p] [-t] [-v] ../../eyes/hazel
+// -n 1 模拟 HalloWing（一只眼睛），默认 2（MONSTER M4SK）；-p 和 -t 与 eyebench
+// 相同；-v 加上语音变调的缓冲区（在列环形缓冲区之前分配）。最后的碎片率
+// 超过 -m 百分比、或第一只眼睛的表分配失败时，退出码为 1，可以在脚本中
+// 检查。
+
+#include <unistd.h>
+#include "../common/hosteye.h"
+
+#define LOAD_ARENA_BYTES 16384 // 与 memory.cpp 相同
+#define VOICE_REC_BYTES  ((int)(3000000.0 / 64.0 / 65.0 * 2.0 + 0.5) * 2) // pdmvoice.cpp
+#define VOICE_MOD_BYTES  ((int)(48000000.0 / 250.0 / 20 + 0.5))
+// M4_Eyes.ino 中分配的列结构的每列字节数：DISPLAY_SIZE 像素和 1 个
+// （MONSTER M4SK）或 NUM_DESCRIPTORS 个（HalloWing，globals.h）16 字节的
+// DMA 描述符；每个列结构还多分配 8 字节，用于把描述符对齐到 16 字节
+#define COLUMN_BYTES(eyes, size) ((size) * 2 + (((eyes) > 1) ? 1 : (3 + 2 * MAX_RUNS)) * 16)
+#define SLOT_ALIGN_BYTES 8
+#define MAX_COLUMNS      8 // globals.h
+#define MAX_BATCH        8
+
+// 一个纹理和它的主机端像素
+typedef struct {
+  texture               tex;
+  std::string           name;
+  std::vector<uint16_t> pixels;
+  std::vector<uint8_t>  index;
+} replayTexture;
+
+static int fragmentation(void) {
+  heapStats s;
+  heapGetStats(&s);
+  return s.freeBytes ? (int)(100 - (uint64_t)s.largestFree * 100 / s.freeBytes) : 0;
+}
+
+static int priority(const presetConfig &cfg, const char *eyeName, const char *key, int def) {
+  def = dwim(cfg.doc[key], def);
+  if(eyeName) def = dwim(cfg.doc[eyeName][key], def);
+  return (def < 0) ? 0 : (def > 255) ? 255 : def;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-r ram] [-s displaysize] [-n eyes] [-k stackreserve] "
+    "[-m maxfrag] [-p] [-t] [-v] preset_dir|config.eye\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int  ram          = 150000;
+  int  displaySize  = 240;
+  int  numEyes      = 2;
+  int  stackReserve = 5192; // globals.h 中的默认值
+  int  maxFrag      = 100;
+  bool indexed      = false;
+  bool tiled        = false;
+  bool voice        = false;
+  int  opt;
+
+  while((opt = getopt(argc, argv, "r:s:n:k:m:ptv")) != -1) {
+    switch(opt) {
+     case 'r': ram          = atoi(optarg); break;
+     case 's': displaySize  = atoi(optarg); break;
+     case 'n': numEyes      = atoi(optarg); break;
+     case 'k': stackReserve = atoi(optarg); break;
+     case 'm': maxFrag      = atoi(optarg); break;
+     case 'p': indexed      = true;         break;
+     case 't': tiled        = true;         break;
+     case 'v': voice        = true;         break;
+     default : usage(argv[0]);
+    }
+  }
+  if((optind >= argc) || (ram < 1024) || (displaySize < 2) || (displaySize > 240) ||
+     (numEyes < 1) || (numEyes > 2)) usage(argv[0]);
+
+  presetConfig cfg[2];
+  const char  *eyeName[2] = { NULL, NULL };
+  if(numEyes > 1) {
+    eyeName[0] = "left";
+    eyeName[1] = "right";
+  }
+  for(int e=0; e<numEyes; e++) {
+    if(!loadPreset(argv[optind], displaySize, eyeName[e], &cfg[e])) return 1;
+  }
+
+  heapSimulate(ram);
+  printf("preset    : %s, %d eye%s, %d bytes RAM\n", argv[optind], numEyes,
+    (numEyes > 1) ? "s" : "", ram);
+  heapReport("启动");
+
+  // 加载阶段：配置、文件名和加载时的临时内存都在区域中 -------------
+
+  void *arena = heapAlloc(HEAP_LOAD, LOAD_ARENA_BYTES);
+  replayTexture textures[4] = { };
+  replayTexture *list[4];
+  int            n = 0;
+  for(int e=0; e<numEyes; e++) {
+    for(int k=0; k<2; k++) {
+      replayTexture *t = &textures[n];
+      t->name              = k ? cfg[e].scleraTexture : cfg[e].irisTexture;
+      t->tex.color         = k ? cfg[e].scleraColor   : cfg[e].irisColor;
+      t->tex.priority      = priority(cfg[e], eyeName[e], k ? "scleraPriority" : "irisPriority",
+        k ? 1 : 2);
+      list[n++] = t;
+    }
+  }
+  // 按优先级排序（稳定，与 texturesByPriority() 相同）
+  std::stable_sort(list, list + n, [](const replayTexture *a, const replayTexture *b) {
+    return a->tex.priority > b->tex.priority; });
+  for(int i=0; i<n; i++) {
+    replayTexture *t = list[i];
+    int            j;
+    for(j=0; (j < i) && !(t->name.size() && (t->name == list[j]->name)); j++);
+    if(j < i) continue; // 共享之前的纹理，不另外分配
+    loadPresetTexture(cfg[0], t->name, &t->tex, t->pixels, t->index, indexed);
+    if(tiled && (t->tex.data != &t->tex.color)) {
+      t->tex.tileHeight = TILE_BYTES / (TILE_WIDTH * (t->tex.index ? 1 : 2));
+    }
+  }
+  heapReport("加载");
+  heapFree(arena);
+
+  // finishTextures()：调色板和块布局的地址表 --------------------------
+
+  std::vector<void *> palettes;
+  for(int i=0; i<n; i++) {
+    replayTexture *t = list[i];
+    int            j;
+    for(j=0; (j < i) && !(t->name.size() && (t->name == list[j]->name)); j++);
+    if((j < i) || (t->tex.data == &t->tex.color)) continue;
+    void *palette = t->tex.index ? heapAlloc(HEAP_TEXTURES, 256 * sizeof(uint16_t)) : NULL;
+    if((t->tex.index && !palette) || (t->tex.tileHeight && !prepareTiles(&t->tex))) {
+      heapFree(palette);
+      printf("%s: no RAM for palette or tile tables, solid color\n", t->name.c_str());
+      t->tex.data = &t->tex.color;
+      continue;
+    }
+    palettes.push_back(palette);
+  }
+
+  // 表：每种不同的几何一组 -----------------------------------------
+
+  eyeTables tables[2] = { 0 };
+  int       setsGenerated = 0;
+  for(int e=0; e<numEyes; e++) {
+    eyeTables *t = &tables[e];
+    t->displaySize     = displaySize;
+    t->eyeRadius       = cfg[e].eyeRadius;
+    t->irisRadius      = cfg[e].irisRadius;
+    t->slitPupilRadius = cfg[e].slitPupilRadius;
+    t->mapRadius       = cfg[e].mapRadius;
+    t->mapDiameter     = cfg[e].mapRadius * 2;
+    if(e && (t->eyeRadius == tables[0].eyeRadius) && (t->irisRadius == tables[0].irisRadius) &&
+       (t->slitPupilRadius == tables[0].slitPupilRadius) && (t->mapRadius == tables[0].mapRadius)) {
+      continue; // 与第一只眼睛共享
+    }
+    if(e && !heapFits(tableSetSize(t) + stackReserve)) {
+      printf("eye #%d tables need %d bytes, not enough RAM, using eye #0 geometry\n",
+        e, tableSetSize(t));
+      continue;
+    }
+    calcMap(t);
+    calcDisplacement(t);
+    if(!t->polar || !t->displace) {
+      printf("eye #%d table allocation failed\n", e);
+      heapReport("表");
+      return 1;
+    }
+    setsGenerated++;
+  }
+  heapReport("表");
+
+  // placeTextures()：按优先级复制到 SRAM ------------------------------
+
+  for(int i=0; i<n; i++) {
+    replayTexture *t = list[i];
+    int            j;
+    for(j=0; (j < i) && !(t->name.size() && (t->name == list[j]->name)); j++);
+    if((j < i) || (t->tex.data == &t->tex.color) || !t->tex.priority) continue;
+    uint32_t bytes = textureBytes(&t->tex);
+    bool     sram  = heapFits(bytes + stackReserve) && heapAlloc(HEAP_TEXTURES, bytes);
+    printf("%s: %dx%d%s%s, %d bytes, priority %d, %s\n", t->name.c_str(),
+      t->tex.width, t->tex.height, t->tex.index ? " indexed" : "", t->tex.tileHeight ? " tiled" : "",
+      (int)bytes, t->tex.priority, sram ? "SRAM" : "flash");
+  }
+  heapReport("纹理");
+
+  if(voice) {
+    void *rec = heapAlloc(HEAP_VOICE, VOICE_REC_BYTES);
+    if(rec) heapAlloc(HEAP_VOICE, VOICE_MOD_BYTES); // 失败时没有调制
+    else    printf("voice buffer allocation failed\n");
+    heapReport("语音");
+  }
+
+  // 列环形缓冲区，与 setup() 相同：先选择每个列结构的列数，然后两只
+  // 眼睛轮流分配，保留 stackReserve
+  int columnRing  = dwim(cfg[0].doc["columnRing"], 4), columns = 2;
+  int batch       = dwim(cfg[0].doc["columnBatch"], 8);
+  int columnBytes = COLUMN_BYTES(numEyes, displaySize);
+  columnRing = (columnRing < 2) ? 2 : (columnRing > MAX_COLUMNS) ? MAX_COLUMNS : columnRing;
+  batch      = (batch < 1) ? 1 : (batch > MAX_BATCH) ? MAX_BATCH : batch;
+  while((batch > 1) &&
+    !heapFits((columnRing - 2) * numEyes * (batch * columnBytes + SLOT_ALIGN_BYTES) + stackReserve)) {
+    batch--;
+  }
+  for(bool ok = true; ok && (columns < columnRing); ) {
+    for(int e=0; ok && (e<numEyes); e++) {
+      ok = heapFits(batch * columnBytes + SLOT_ALIGN_BYTES + stackReserve) &&
+           heapAlloc(HEAP_COLUMNS, batch * columnBytes + SLOT_ALIGN_BYTES);
+    }
+    if(ok) columns++;
+  }
+  printf("columns   : %d per eye (columnRing %d), 2 x 1 + %d x %d columns\n",
+    columns, columnRing, columns - 2, batch);
+  heapReport("列");
+
+  int frag = fragmentation();
+  printf("result    : %d table set%s, fragmentation %d%% (limit %d%%)\n",
+    setsGenerated, (setsGenerated == 1) ? "" : "s", frag, maxFrag);
+  return (frag > maxFrag) ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 检查 tablegen.cpp 中 calcMap() 的狭缝瞳孔二分查找与原来逐个尝试每个圆
+// 的循环结果相同。对一系列屏幕大小、眼睛、虹膜、狭缝半径和覆盖率，用
+// calcMap() 生成极坐标地图，再用原来的循环重新计算虹膜中每个像素的距离
+// 比较。修改 calcMap() 的狭缝瞳孔部分之后运行。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -o slitcheck slitcheck.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./slitcheck [-v]
+// -v 打印每个几何。有不同的条目时退出码为 1。
+
+#include <unistd.h>
+#include "../common/hosteye.h"
+
+// 原来的 calcMap() 中虹膜像素 (x, y) 的距离：先是圆形瞳孔的距离，然后
+// 从 126 开始逐个尝试每个狭缝瞳孔的圆
+static int8_t linearDist(const eyeTables *tables, int x, int y) {
+  float iRad = screen2map(tables, tables->irisRadius);
+  float dx   = (float)x + 0.5, dy = (float)y + 0.5;
+  float d    = sqrt(dx * dx + dy * dy);
+  d = (iRad - d) / iRad;
+  d *= -127.0;
+  int8_t dist = (int8_t)d - 1;
+  float  xp   = x + 0.5, dy2 = dy * dy;
+  for(int i=126; i>=0; i--) {
+    float ratio = i / 128.0;
+    float y1    = iRad - (iRad - tables->slitPupilRadius) * ratio;
+    float x2    = iRad * (1.0 - ratio);
+    float xc    = (x2 * x2 - y1 * y1) / (2 * x2);
+    dx = x2 - xc;
+    float r2 = dx * dx;
+    dx = xp - xc;
+    if((dx * dx + dy2) <= r2) {
+      dist = (int8_t)(-1 - i);
+      break;
+    }
+  }
+  return dist;
+}
+
+// 比较一个几何的表，返回不同的条目数
+static int check(int displaySize, int eyeRadius, int irisRadius, int slitPupilRadius,
+  float coverage) {
+  eyeTables t = { 0 };
+  t.displaySize     = displaySize;
+  t.eyeRadius       = eyeRadius;
+  t.irisRadius      = irisRadius;
+  t.slitPupilRadius = slitPupilRadius;
+  t.mapRadius       = (int)(eyeRadius * M_PI * coverage + 0.5);
+  t.mapDiameter     = t.mapRadius * 2;
+  calcMap(&t);
+  if(!t.polar) {
+    fprintf(stderr, "calcMap() allocation failed\n");
+    exit(1);
+  }
+  const int R           = t.mapRadius;
+  float     iRad        = screen2map(&t, irisRadius);
+  float     irisRadius2 = iRad * iRad;
+  int       bad         = 0;
+  for(int x=0; x<R; x++) {
+    for(int y=0; y<R; y++) {
+      float dx = x + 0.5, dy = y + 0.5;
+      if((dx * dx + dy * dy) > irisRadius2) continue; // 只有虹膜被覆盖
+      int8_t want = linearDist(&t, x, y), got = t.polar[x * R + y].dist;
+      if(got != want) {
+        if(!bad) {
+          printf("display %d eye %d iris %d slit %d coverage %.1f: "
+            "(%d, %d) dist %d, expected %d\n", displaySize, eyeRadius, irisRadius,
+            slitPupilRadius, coverage, x, y, got, want);
+        }
+        bad++;
+      }
+    }
+  }
+  heapFree((void *)t.polar);
+  return bad;
+}
+
+int main(int argc, char *argv[]) {
+  bool verbose = false;
+  int  opt;
+
+  while((opt = getopt(argc, argv, "v")) != -1) {
+    switch(opt) {
+     case 'v': verbose = true; break;
+     default :
+      fprintf(stderr, "Usage: %s [-v]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  static const int   sizes[]    = { 128, 160, 240 };
+  static const float coverage[] = { 0.4, 0.6, 0.9 };
+  int geometries = 0, failed = 0;
+  for(int s : sizes) {
+    int eyes[] = { s / 2 - 10, s / 2 + 5, s / 2 + 25 }; // 小于、等于和大于默认值
+    for(int eyeRadius : eyes) {
+      for(int iris = s / 8; iris < eyeRadius; iris += s / 16) {
+        for(int slit = 1; slit <= iris; slit += (slit < 8) ? 3 : iris / 4) {
+          for(float c : coverage) {
+            int bad = check(s, eyeRadius, iris, slit, c);
+            if(verbose) {
+              printf("display %d eye %d iris %d slit %d coverage %.1f: %d bad\n",
+                s, eyeRadius, iris, slit, c, bad);
+            }
+            geometries++;
+            if(bad) failed++;
+          }
+        }
+      }
+    }
+  }
+  printf("%d geometries, %d with differences\n", geometries, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,241 @@
+// SPDX-FileCopyrightText: 2019 Phillip Burgess for Adafruit Industries
+//
+// SPDX-License-Identifier: MIT
+
+//34567890123456789012345678901234567890123456789012345678901234567890123456
+
+// 纹理缓存模拟。纹理放在内部闪存中，经过 SAMD51 的 CMCC 缓存读取
+// （4 KB，4 路组相联，16 字节的行，LRU）。渲染器沿屏幕的列行进，
+// 而纹理采样点按极坐标在纹理中跳跃，所以纹理在闪存中的排列方式
+// 决定了每帧有多少次缓存未命中。
+//
+// 此工具用与 eyebench 相同的帧序列渲染预设，用 -DRENDER_TRACE 编译的
+// render.cpp 报告每次纹理读取，然后把同一个读取序列按几种纹理布局
+// （逐行、逐列、不同大小的块）分别映射到闪存地址，送入各自的缓存模型，
+// 比较未命中次数。
+//
+// 编译（在此目录中）：
+//   g++ -O2 -DRENDER_TRACE -o texcache texcache.cpp ../../render.cpp ../../tablegen.cpp ../../heapstat.cpp
+// 用法：
+//   ./texcache [-f frames] [-s displaysize] [-e left|right] [-p] ../../eyes/hazel
+//
+// 模型只包括纹理数据读取。在开发板上，CMCC 也缓存从闪存取出的指令，
+// 渲染内核本身也占用一部分缓存行，所以实际的未命中率会更高一些；
+// 这里的数字用于比较布局，而不是预测绝对性能。
+
+#include <unistd.h>
+#include "../common/hosteye.h"
+
+#define CACHE_LINE_BITS 4 // 16 字节的行
+#define CACHE_SETS      64
+#define CACHE_WAYS      4
+
+// 一个 CMCC 模型
+typedef struct {
+  uint32_t tag[CACHE_SETS][CACHE_WAYS];
+  uint32_t age[CACHE_SETS][CACHE_WAYS];
+  uint32_t clock;
+  uint64_t accesses, misses;
+} cacheModel;
+
+static void cacheReset(cacheModel *c) {
+  memset(c, 0, sizeof *c);
+  memset(c->tag, 0xFF, sizeof c->tag);
+}
+
+static void cacheAccess(cacheModel *c, uint32_t addr) {
+  uint32_t line = addr >> CACHE_LINE_BITS;
+  uint32_t set  = line % CACHE_SETS, tag = line / CACHE_SETS;
+  int      victim = 0;
+  c->accesses++;
+  c->clock++;
+  for(int w=0; w<CACHE_WAYS; w++) {
+    if(c->tag[set][w] == tag) {
+      c->age[set][w] = c->clock;
+      return;
+    }
+    if(c->age[set][w] < c->age[set][victim]) victim = w;
+  }
+  c->misses++;
+  c->tag[set][victim] = tag;
+  c->age[set][victim] = c->clock;
+}
+
+// 纹理布局：纹理分成 tileW x tileH 像素的块，块按行排列，块内的像素也按行
+// 排列。tileW = 纹理宽度、tileH = 1 就是当前的逐行布局；tileW = 1、
+// tileH = 纹理高度是逐列布局。
+typedef struct {
+  const char *name;
+  int         tileW, tileH; // 0 = 纹理宽度或高度
+} layout;
+
+static const layout layouts[] = {
+  { "row-major"  , 0,  1 },
+  { "column-major", 1, 0 },
+  { "tile 2x2"   , 2,  2 },
+  { "tile 4x2"   , 4,  2 },
+  { "tile 2x4"   , 2,  4 },
+  { "tile 4x4"   , 4,  4 },
+  { "tile 8x2"   , 8,  2 },
+  { "tile 8x4"   , 8,  4 },
+  { "tile 8x8"   , 8,  8 },
+  { "tile 16x4"  , 16, 4 },
+  { "tile 1x8"   , 1,  8 },
+  { "tile 2x8"   , 2,  8 },
+  { "tile 4x8"   , 4,  8 },
+  { "tile 1x16"  , 1, 16 },
+};
+#define NUM_LAYOUTS (int)(sizeof layouts / sizeof layouts[0])
+
+// 一个被跟踪的纹理：渲染器读取的数组（像素或索引）和它在每种布局下的
+// 闪存地址
+typedef struct {
+  const uint8_t *base;  // 渲染器读取的数组，NULL = 纯色
+  int            bytes; // 每像素字节数
+  int            width, height;
+  uint32_t       flash[NUM_LAYOUTS]; // 每种布局下在闪存中的起始地址
+} tracedTexture;
+
+static tracedTexture traced[2];
+static cacheModel    caches[NUM_LAYOUTS];
+
+// 像素 (x, y) 在布局 l 中的偏移（像素）
+static uint32_t layoutOffset(const tracedTexture *t, int l, int x, int y) {
+  int tw = layouts[l].tileW ? layouts[l].tileW : t->width;
+  int th = layouts[l].tileH ? layouts[l].tileH : t->height;
+  int tilesPerRow = (t->width + tw - 1) / tw;
+  return ((uint32_t)(y / th) * tilesPerRow + (x / tw)) * (tw * th) +
+    (y % th) * tw + (x % tw);
+}
+
+// 布局 l 中纹理的大小（字节），包括块的填充
+static uint32_t layoutBytes(const tracedTexture *t, int l) {
+  int tw = layouts[l].tileW ? layouts[l].tileW : t->width;
+  int th = layouts[l].tileH ? layouts[l].tileH : t->height;
+  return (uint32_t)((t->width + tw - 1) / tw) * tw *
+    ((t->height + th - 1) / th) * th * t->bytes;
+}
+
+// render.cpp（用 -DRENDER_TRACE 编译时）对每次纹理读取调用此函数
+void renderTrace(const void *addr, int bytes) {
+  const uint8_t *a = (const uint8_t *)addr;
+  for(int n=0; n<2; n++) {
+    tracedTexture *t = &traced[n];
+    if(!t->base || (a < t->base) ||
+       (a >= t->base + (size_t)t->width * t->height * t->bytes)) continue;
+    int i = (a - t->base) / bytes;
+    int x = i % t->width, y = i / t->width;
+    for(int l=0; l<NUM_LAYOUTS; l++) {
+      cacheAccess(&caches[l], t->flash[l] + layoutOffset(t, l, x, y) * bytes);
+    }
+    return;
+  }
+}
+
+static void traceTexture(tracedTexture *t, const texture *tex) {
+  t->base   = tex->index ? tex->index : (const uint8_t *)tex->data;
+  t->bytes  = tex->index ? 1 : 2;
+  t->width  = tex->width;
+  t->height = tex->height;
+  if(tex->data == &tex->color) t->base = NULL; // 纯色，不读取闪存
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [-f frames] [-s displaysize] [-e left|right] [-p] "
+    "preset_dir|config.eye\n", prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int         frames      = 200;
+  int         displaySize = 240;
+  const char *eyeName     = NULL;
+  bool        indexed     = false;
+  int         opt;
+
+  while((opt = getopt(argc, argv, "f:s:e:p")) != -1) {
+    switch(opt) {
+     case 'f': frames      = atoi(optarg); break;
+     case 's': displaySize = atoi(optarg); break;
+     case 'e': eyeName     = optarg;       break;
+     case 'p': indexed     = true;         break;
+     default : usage(argv[0]);
+    }
+  }
+  if((optind >= argc) || (frames < 1) || (displaySize < 2) || (displaySize > 240)) usage(argv[0]);
+
+  presetConfig cfg;
+  if(!loadPreset(argv[optind], displaySize, eyeName, &cfg)) return 1;
+
+  eyeTables tables = { 0 };
+  tables.displaySize     = displaySize;
+  tables.eyeRadius       = cfg.eyeRadius;
+  tables.irisRadius      = cfg.irisRadius;
+  tables.slitPupilRadius = cfg.slitPupilRadius;
+  tables.mapRadius       = cfg.mapRadius;
+  tables.mapDiameter     = cfg.mapRadius * 2;
+  calcMap(&tables);
+  calcDisplacement(&tables);
+  if(!tables.polar || !tables.displace) {
+    fprintf(stderr, "Table allocation failed\n");
+    return 1;
+  }
+
+  texture               iris = { 0 }, sclera = { 0 };
+  std::vector<uint16_t> irisPixels, scleraPixels;
+  std::vector<uint8_t>  irisIndex, scleraIndex;
+  iris.color   = cfg.irisColor;
+  sclera.color = cfg.scleraColor;
+  loadPresetTexture(cfg, cfg.irisTexture  , &iris  , irisPixels  , irisIndex  , indexed);
+  loadPresetTexture(cfg, cfg.scleraTexture, &sclera, scleraPixels, scleraIndex, indexed);
+  iris.mirror   = cfg.irisMirror;
+  sclera.mirror = cfg.scleraMirror;
+  prepareTexture(&iris);
+  prepareTexture(&sclera);
+  columnRenderer renderer = selectRenderer(&iris, &sclera);
+
+  // 纹理在闪存中一个接一个，每个从新的一页开始（与 memory.cpp 相同）
+  traceTexture(&traced[0], &iris);
+  traceTexture(&traced[1], &sclera);
+  for(int l=0; l<NUM_LAYOUTS; l++) {
+    uint32_t addr = 0x20000;
+    for(int n=0; n<2; n++) {
+      traced[n].flash[l] = addr;
+      if(traced[n].base) addr += (layoutBytes(&traced[n], l) + 511) & ~511;
+    }
+    cacheReset(&caches[l]);
+  }
+
+  eyeRenderState state;
+  state.pupilColor  = cfg.pupilColor;
+  state.backColor   = cfg.backColor;
+  state.eyelidColor = cfg.eyelidIndex * 0x0101;
+  state.iris        = &iris;
+  state.sclera      = &sclera;
+  state.runs        = NULL;
+  state.pupilRuns   = false;
+
+  std::vector<uint16_t> column(displaySize);
+  for(int f=0; f<frames; f++) {
+    presetFrame(cfg, &tables, f, &iris, &sclera, &state);
+    for(int x=0; x<displaySize; x++) {
+      renderer(&tables, &state, x, 0, displaySize - 1, column.data());
+    }
+  }
+
+  printf("preset    : %s%s%s\n", argv[optind], eyeName ? " eye " : "", eyeName ? eyeName : "");
+  printf("textures  : iris %dx%d%s, sclera %dx%d%s\n",
+    iris.width, iris.height, iris.index ? " indexed" : "",
+    sclera.width, sclera.height, sclera.index ? " indexed" : "");
+  printf("reads     : %.0f texture reads/frame\n", (double)caches[0].accesses / frames);
+  for(int l=0; l<NUM_LAYOUTS; l++) {
+    printf("%-12s: %8.0f misses/frame, miss rate %5.2f%%, %+6.1f%% vs row-major\n",
+      layouts[l].name, (double)caches[l].misses / frames,
+      caches[l].accesses ? 100.0 * caches[l].misses / caches[l].accesses : 0.0,
+      caches[0].misses ? 100.0 * ((double)caches[l].misses / caches[0].misses - 1.0) : 0.0);
+  }
+
+  heapFree((void *)tables.polar);
+  heapFree((void *)tables.displace);
+  return 0;
+}
@@ -42,9 +42,10 @@ void user_setup(void) {
     entry = arcada.openFileByIndex(wav_path, i, O_READ, "wav");
     if(!entry) break;
     // Found one, alloc new wavlist struct, try duplicating filename
-    if((wptr = (struct wavlist *)malloc(sizeof(struct wavlist)))) {
+    if((wptr = (struct wavlist *)heapAlloc(HEAP_USER, sizeof(struct wavlist)))) {
       entry.getName(filename, SD_MAX_FILENAME_SIZE);
-      if((wptr->filename = strdup(filename))) {
+      if((wptr->filename = (char *)heapAlloc(HEAP_USER, strlen(filename) + 1))) {
+        strcpy(wptr->filename, filename);
         // Alloc'd OK, add to linked list...
         if(wavListPtr) {           // List already started?
           wavListPtr->next = wptr; // Point prior last item to new one
@@ -53,7 +54,7 @@ void user_setup(void) {
         }
         wavListPtr = wptr;         // Update last item to new one
       } else {
-        free(wptr);                // Alloc failed, delete interim stuff
+        heapFree(wptr);            // Alloc failed, delete interim stuff
       }
     }
     entry.close();